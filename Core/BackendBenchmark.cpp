@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    BackendBenchmark.cpp
+    Runs benchmarkFilterBackends() at the common host rates and prints the
+    timings and the accuracy of the SVF backend against the biquads:
+
+        eq-backend-bench [block size] [seconds per run]
+
+    Exits non-zero when a rate's responses differ by more than
+    FilterBackendBenchmark::magnitudeToleranceDb.
+
+  ==============================================================================
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include "../Source/EQCore.h"
+
+int main(int argc, char* argv[]) {
+    auto blockSize = argc > 1 ? juce::jlimit(1, 8192, std::atoi(argv[1])) : 512;
+    auto seconds = argc > 2 ? juce::jlimit(0.1, 600.0, std::atof(argv[2])) : 10.0;
+
+    std::printf("block %d, %.1f s of noise per run; ns/sample and ns/redesign are biquad / svf\n", blockSize, seconds);
+    std::printf("%8s %17s %17s %15s %14s %14s\n", "rate", "static ns", "modulated ns", "redesign ns", "response dB", "output dB");
+
+    auto allWithinTolerance = true;
+
+    for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 }) {
+        auto result = benchmarkFilterBackends(sampleRate, blockSize, (int)(sampleRate * seconds));
+        allWithinTolerance = allWithinTolerance && result.isWithinTolerance();
+
+        std::printf("%8.0f %8.2f / %6.2f %8.2f / %6.2f %7.0f / %5.0f %14.4f %14.1f%s\n", sampleRate,
+            result.biquadNsPerSample, result.svfNsPerSample,
+            result.biquadModulatedNsPerSample, result.svfModulatedNsPerSample,
+            result.biquadUpdateNs, result.svfUpdateNs,
+            result.maxMagnitudeErrorDb, result.maxOutputErrorDb,
+            result.isWithinTolerance() ? "" : "  over tolerance");
+    }
+
+    return allWithinTolerance ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+/*
+  ==============================================================================
+
+    BenchmarkClient.cpp
+    Load test for the EQ service, and an example client: it only needs
+    ServiceProtocol.h, no JUCE.
+
+        g++ -O2 -std=c++17 -pthread -o eq-service-bench Service/BenchmarkClient.cpp
+        eq-service-bench [streams] [seconds] [block frames] [blocks in flight] [socket path]
+
+    Each stream opens its own connection and keeps up to 'blocks in flight'
+    blocks of noise queued, timing each from being written to the input ring
+    until its last frame is in the output ring.
+
+  ==============================================================================
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <vector>
+#include "ServiceProtocol.h"
+
+using namespace eqservice;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    int numStreams = 8;
+    double seconds = 10.0;
+    uint32_t blockFrames = 256;
+    uint32_t blocksInFlight = 2;
+    std::string socketPath = defaultSocketPath;
+    double sampleRate = 48000.0;
+};
+
+struct StreamResult {
+    bool ok = false;
+    uint64_t frames = 0;
+    std::vector<double> latenciesMicroseconds;
+};
+
+bool writeFully(int fd, const void* data, size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        auto sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool readFully(int fd, void* data, size_t size) {
+    auto* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        auto received = recv(fd, bytes, size, 0);
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+//sends a request and reads its reply, which must be 'replyType' and fit 'reply'
+bool request(int fd, MessageType type, const void* payload, uint32_t size, MessageType replyType, void* reply, uint32_t replySize) {
+    MessageHeader header { type, size };
+    if (!writeFully(fd, &header, sizeof(header)) || !writeFully(fd, payload, size))
+        return false;
+
+    if (!readFully(fd, &header, sizeof(header)))
+        return false;
+
+    std::vector<char> body(header.size);
+    if (!readFully(fd, body.data(), body.size()))
+        return false;
+
+    if (header.type != replyType || header.size < replySize)
+        return false;
+
+    std::memcpy(reply, body.data(), replySize);
+    return true;
+}
+
+int connectToService(const std::string& path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+uint32_t nextPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+StreamResult runStream(const Options& options, int streamIndex) {
+    StreamResult result;
+
+    auto fd = connectToService(options.socketPath);
+    if (fd < 0) {
+        std::fprintf(stderr, "stream %d: couldn't connect to %s\n", streamIndex, options.socketPath.c_str());
+        return result;
+    }
+
+    OpenStreamRequest open { options.sampleRate, options.blockFrames,
+        nextPowerOfTwo(std::max(2u, options.blocksInFlight) * options.blockFrames) };
+    StreamOpenedReply opened {};
+
+    if (!request(fd, MessageType::OpenStream, &open, sizeof(open), MessageType::StreamOpened, &opened, sizeof(opened))
+        || opened.status != StatusCode::Ok) {
+        std::fprintf(stderr, "stream %d: open failed (status %u)\n", streamIndex, (unsigned)opened.status);
+        close(fd);
+        return result;
+    }
+
+    opened.sharedMemoryName[sizeof(opened.sharedMemoryName) - 1] = 0;
+    auto memoryFd = shm_open(opened.sharedMemoryName, O_RDWR, 0);
+    auto* memory = memoryFd >= 0
+        ? mmap(nullptr, opened.sharedMemoryBytes, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0)
+        : MAP_FAILED;
+    if (memoryFd >= 0)
+        close(memoryFd);
+
+    auto* shared = memory != MAP_FAILED ? static_cast<StreamHeader*>(memory) : nullptr;
+    if (shared == nullptr || shared->magic != streamMagic || shared->version != protocolVersion) {
+        std::fprintf(stderr, "stream %d: couldn't map %s\n", streamIndex, opened.sharedMemoryName);
+        if (shared != nullptr)
+            munmap(memory, opened.sharedMemoryBytes);
+        close(fd);
+        return result;
+    }
+
+    SetParameterRequest boost { opened.streamId, "Peak Gain", 6.f };
+    StatusReply status {};
+    request(fd, MessageType::SetParameter, &boost, sizeof(boost), MessageType::Status, &status, sizeof(status));
+
+    auto* inputRing = reinterpret_cast<float*>(static_cast<char*>(memory) + getRingOffset(false, shared->ringFrames));
+    auto* outputRing = reinterpret_cast<float*>(static_cast<char*>(memory) + getRingOffset(true, shared->ringFrames));
+    const uint64_t ringFrames = shared->ringFrames, mask = ringFrames - 1, block = options.blockFrames;
+
+    std::mt19937 random((unsigned)streamIndex + 1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    //submission time of each block still in flight, oldest first
+    std::deque<Clock::time_point> inFlight;
+    uint64_t completed = 0;
+    float checksum = 0.f;
+
+    auto deadline = Clock::now() + std::chrono::duration<double>(options.seconds);
+
+    while (!shared->closed.load(std::memory_order_acquire)) {
+        auto sequence = shared->clientSequence.load(std::memory_order_acquire);
+        bool progressed = false;
+
+        auto inputWrite = shared->inputWritePosition.load(std::memory_order_relaxed);
+        if (Clock::now() < deadline && inFlight.size() < options.blocksInFlight
+            && ringFrames - (inputWrite - shared->inputReadPosition.load(std::memory_order_acquire)) >= block) {
+            for (uint64_t i = 0; i < block; ++i) {
+                auto index = (size_t)((inputWrite + i) & mask) * numStreamChannels;
+                inputRing[index] = noise(random);
+                inputRing[index + 1] = noise(random);
+            }
+
+            shared->inputWritePosition.store(inputWrite + block, std::memory_order_release);
+            inFlight.push_back(Clock::now());
+            notify(shared->serviceSequence);
+            progressed = true;
+        }
+
+        auto outputRead = shared->outputReadPosition.load(std::memory_order_relaxed);
+        auto outputWrite = shared->outputWritePosition.load(std::memory_order_acquire);
+        if (outputWrite != outputRead) {
+            for (auto position = outputRead; position != outputWrite; ++position)
+                checksum += outputRing[(size_t)(position & mask) * numStreamChannels];
+
+            shared->outputReadPosition.store(outputWrite, std::memory_order_release);
+            notify(shared->serviceSequence);
+            progressed = true;
+
+            auto now = Clock::now();
+            while (!inFlight.empty() && outputWrite >= completed + block) {
+                result.latenciesMicroseconds.push_back(std::chrono::duration<double, std::micro>(now - inFlight.front()).count());
+                inFlight.pop_front();
+                completed += block;
+            }
+        }
+
+        if (Clock::now() >= deadline && inFlight.empty())
+            break;
+
+        if (!progressed)
+            futexWait(shared->clientSequence, sequence, 10000000L);
+    }
+
+    result.ok = !shared->closed.load() && std::isfinite(checksum);
+    result.frames = completed;
+
+    CloseStreamRequest closeRequest { opened.streamId };
+    request(fd, MessageType::CloseStream, &closeRequest, sizeof(closeRequest), MessageType::Status, &status, sizeof(status));
+
+    munmap(memory, opened.sharedMemoryBytes);
+    close(fd);
+    return result;
+}
+
+double getPercentile(std::vector<double>& sorted, double fraction) {
+    if (sorted.empty())
+        return 0.0;
+    auto index = (size_t)std::min((double)sorted.size() - 1.0, std::floor(fraction * (double)sorted.size()));
+    return sorted[index];
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (argc > 1) options.numStreams = std::max(1, std::atoi(argv[1]));
+    if (argc > 2) options.seconds = std::max(0.1, std::atof(argv[2]));
+    if (argc > 3) options.blockFrames = (uint32_t)std::clamp(std::atoi(argv[3]), 1, 8192);
+    if (argc > 4) options.blocksInFlight = (uint32_t)std::clamp(std::atoi(argv[4]), 1, 64);
+    if (argc > 5) options.socketPath = argv[5];
+
+    std::vector<StreamResult> results((size_t)options.numStreams);
+    std::vector<std::thread> threads;
+
+    auto start = Clock::now();
+    for (int i = 0; i < options.numStreams; ++i)
+        threads.emplace_back([&, i] { results[(size_t)i] = runStream(options, i); });
+    for (auto& thread : threads)
+        thread.join();
+    auto wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t totalFrames = 0;
+    int failed = 0;
+    std::vector<double> latencies;
+    for (auto& result : results) {
+        failed += result.ok ? 0 : 1;
+        totalFrames += result.frames;
+        latencies.insert(latencies.end(), result.latenciesMicroseconds.begin(), result.latenciesMicroseconds.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    auto realtimeFactor = (double)totalFrames / options.sampleRate / wallSeconds;
+
+    std::printf("streams %d (%d failed), block %u frames, %u in flight\n",
+        options.numStreams, failed, options.blockFrames, options.blocksInFlight);
+    std::printf("frames %llu in %.2f s, %.1fx realtime in total, %.2fx per stream\n",
+        (unsigned long long)totalFrames, wallSeconds, realtimeFactor, realtimeFactor / options.numStreams);
+    std::printf("block round trip us: p50 %.1f, p99 %.1f, max %.1f (block lasts %.1f)\n",
+        getPercentile(latencies, 0.5), getPercentile(latencies, 0.99), latencies.empty() ? 0.0 : latencies.back(),
+        1.0e6 * options.blockFrames / options.sampleRate);
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,434 @@
+/*
+  ==============================================================================
+
+    EQService.cpp
+    Hosts EQAudioProcessor instances for processes that can't load plugins.
+
+  ==============================================================================
+*/
+
+#include "EQService.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using namespace eqservice;
+
+namespace {
+
+//false once the peer has gone or the thread has been asked to stop
+bool readFully(int fd, void* data, size_t size, juce::Thread& thread) {
+    auto* bytes = static_cast<char*>(data);
+
+    while (size > 0) {
+        pollfd request { fd, POLLIN, 0 };
+        auto ready = poll(&request, 1, 100);
+
+        if (thread.threadShouldExit())
+            return false;
+        if (ready < 0 && errno != EINTR)
+            return false;
+        if (ready <= 0)
+            continue;
+
+        auto received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+
+        bytes += received;
+        size -= (size_t)received;
+    }
+
+    return true;
+}
+
+bool writeFully(int fd, const void* data, size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        auto sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+bool sendMessage(int fd, MessageType type, const void* payload, size_t size, const void* extra = nullptr, size_t extraSize = 0) {
+    MessageHeader header { type, (uint32_t)(size + extraSize) };
+
+    return writeFully(fd, &header, sizeof(header))
+        && writeFully(fd, payload, size)
+        && (extraSize == 0 || writeFully(fd, extra, extraSize));
+}
+
+bool sendStatus(int fd, StatusCode status) {
+    StatusReply reply { status };
+    return sendMessage(fd, MessageType::Status, &reply, sizeof(reply));
+}
+
+bool isValidRequest(const OpenStreamRequest& request) {
+    auto isPowerOfTwo = [](uint32_t value) { return value != 0 && (value & (value - 1)) == 0; };
+
+    return request.sampleRate >= 8000.0 && request.sampleRate <= 384000.0
+        && request.maxBlockFrames >= 1 && request.maxBlockFrames <= 8192
+        && isPowerOfTwo(request.ringFrames) && request.ringFrames <= (1u << 20)
+        && request.ringFrames >= 2 * request.maxBlockFrames;
+}
+
+}
+
+//==============================================================================
+
+ServiceStream::ServiceStream(uint32_t streamId, const OpenStreamRequest& request) :
+    juce::Thread("EQ stream " + juce::String(streamId)),
+    id(streamId)
+{
+    sharedMemoryName = "/eq-service-" + juce::String((int)getpid()) + "-" + juce::String(streamId);
+    sharedMemoryBytes = eqservice::getSharedMemoryBytes(request.ringFrames);
+
+    sharedMemoryFd = shm_open(sharedMemoryName.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (sharedMemoryFd < 0)
+        return;
+
+    if (ftruncate(sharedMemoryFd, (off_t)sharedMemoryBytes) != 0)
+        return;
+
+    auto* memory = mmap(nullptr, sharedMemoryBytes, PROT_READ | PROT_WRITE, MAP_SHARED, sharedMemoryFd, 0);
+    if (memory == MAP_FAILED)
+        return;
+
+    //ftruncate zeroed the rings; the header is constructed in place
+    header = new (memory) StreamHeader {};
+    header->version = protocolVersion;
+    header->numChannels = numStreamChannels;
+    header->ringFrames = request.ringFrames;
+    header->maxBlockFrames = request.maxBlockFrames;
+    header->sampleRate = request.sampleRate;
+
+    inputRing = reinterpret_cast<float*>(static_cast<char*>(memory) + getRingOffset(false, request.ringFrames));
+    outputRing = reinterpret_cast<float*>(static_cast<char*>(memory) + getRingOffset(true, request.ringFrames));
+
+    processor.setRateAndBufferSizeDetails(request.sampleRate, (int)request.maxBlockFrames);
+    processor.prepareToPlay(request.sampleRate, (int)request.maxBlockFrames);
+    blockBuffer.setSize((int)numStreamChannels, (int)request.maxBlockFrames);
+
+    header->magic = streamMagic;
+    startThread();
+}
+
+ServiceStream::~ServiceStream() {
+    if (header != nullptr) {
+        signalThreadShouldExit();
+        notify(header->serviceSequence);
+        stopThread(1000);
+
+        header->closed.store(1, std::memory_order_release);
+        notify(header->clientSequence);
+
+        processor.releaseResources();
+        munmap(header, sharedMemoryBytes);
+    }
+
+    //a client that has it mapped keeps its mapping
+    if (sharedMemoryFd >= 0) {
+        close(sharedMemoryFd);
+        shm_unlink(sharedMemoryName.toRawUTF8());
+    }
+}
+
+StatusCode ServiceStream::setParameter(const juce::String& parameterId, float value) {
+    auto* parameter = processor.apvts.getParameter(parameterId);
+    if (parameter == nullptr)
+        return StatusCode::UnknownParameter;
+
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    return StatusCode::Ok;
+}
+
+StatusCode ServiceStream::setState(const void* data, size_t size) {
+    if (!juce::ValueTree::readFromData(data, size).isValid())
+        return StatusCode::InvalidState;
+
+    const juce::ScopedLock lock(processLock);
+    processor.setStateInformation(data, (int)size);
+    return StatusCode::Ok;
+}
+
+juce::MemoryBlock ServiceStream::getState() {
+    juce::MemoryBlock state;
+
+    const juce::ScopedLock lock(processLock);
+    processor.getStateInformation(state);
+    return state;
+}
+
+void ServiceStream::run() {
+    EQ_TRACE_THREAD_NAME("Service stream");
+
+    auto& shared = *header;
+    const uint64_t ringFrames = shared.ringFrames, mask = ringFrames - 1;
+    juce::MidiBuffer midi;
+
+    while (!threadShouldExit()) {
+        //read before the positions, so a ring arriving after them isn't missed
+        auto sequence = shared.serviceSequence.load(std::memory_order_acquire);
+
+        auto inputRead = shared.inputReadPosition.load(std::memory_order_relaxed);
+        auto outputWrite = shared.outputWritePosition.load(std::memory_order_relaxed);
+        auto available = shared.inputWritePosition.load(std::memory_order_acquire) - inputRead;
+        auto space = ringFrames - (outputWrite - shared.outputReadPosition.load(std::memory_order_acquire));
+
+        //positions come from the client, so everything is clamped and masked
+        auto frames = (int)std::min({ available, space, (uint64_t)shared.maxBlockFrames });
+        if (frames <= 0) {
+            futexWait(shared.serviceSequence, sequence, 100000000L);
+            continue;
+        }
+
+        juce::AudioBuffer<float> block(blockBuffer.getArrayOfWritePointers(), (int)numStreamChannels, frames);
+        auto* left = block.getWritePointer(0);
+        auto* right = block.getWritePointer(1);
+
+        for (int i = 0; i < frames; ++i) {
+            auto index = (size_t)((inputRead + (uint64_t)i) & mask) * numStreamChannels;
+            left[i] = inputRing[index];
+            right[i] = inputRing[index + 1];
+        }
+        shared.inputReadPosition.store(inputRead + (uint64_t)frames, std::memory_order_release);
+
+        {
+            const juce::ScopedLock lock(processLock);
+            processor.processBlock(block, midi);
+        }
+
+        for (int i = 0; i < frames; ++i) {
+            auto index = (size_t)((outputWrite + (uint64_t)i) & mask) * numStreamChannels;
+            outputRing[index] = left[i];
+            outputRing[index + 1] = right[i];
+        }
+        shared.outputWritePosition.store(outputWrite + (uint64_t)frames, std::memory_order_release);
+
+        notify(shared.clientSequence);
+    }
+}
+
+//==============================================================================
+
+struct EQService::Connection : private juce::Thread {
+    Connection(EQService& newOwner, int newFd) :
+        juce::Thread("EQ service connection"),
+        owner(newOwner),
+        fd(newFd)
+    {
+        startThread();
+    }
+
+    ~Connection() override {
+        stopThread(2000);
+    }
+
+    bool isFinished() const { return finished.load(); }
+private:
+    void run() override {
+        juce::MemoryBlock payload;
+
+        while (!threadShouldExit()) {
+            MessageHeader header;
+            if (!readFully(fd, &header, sizeof(header), *this) || header.size > maxMessageBytes)
+                break;
+
+            payload.setSize(header.size);
+            if (header.size > 0 && !readFully(fd, payload.getData(), header.size, *this))
+                break;
+
+            if (!handle(header.type, payload))
+                break;
+        }
+
+        streams.clear();
+        close(fd);
+        finished.store(true);
+    }
+
+    ServiceStream* findStream(const juce::MemoryBlock& payload) {
+        if (payload.getSize() < sizeof(StreamIdPayload))
+            return nullptr;
+
+        auto it = streams.find(static_cast<const StreamIdPayload*>(payload.getData())->streamId);
+        return it != streams.end() ? it->second.get() : nullptr;
+    }
+
+    //false when the reply couldn't be sent and the connection is done
+    bool handle(MessageType type, const juce::MemoryBlock& payload) {
+        switch (type) {
+        case MessageType::OpenStream: {
+            StreamOpenedReply reply {};
+
+            if (payload.getSize() != sizeof(OpenStreamRequest)) {
+                reply.status = StatusCode::BadRequest;
+            }
+            else if (streams.size() >= maxStreamsPerConnection) {
+                reply.status = StatusCode::OutOfResources;
+            }
+            else {
+                OpenStreamRequest request;
+                payload.copyTo(&request, 0, sizeof(request));
+
+                if (!isValidRequest(request)) {
+                    reply.status = StatusCode::BadRequest;
+                }
+                else {
+                    auto stream = std::make_unique<ServiceStream>(owner.nextStreamId.fetch_add(1), request);
+
+                    if (!stream->isValid()) {
+                        reply.status = StatusCode::OutOfResources;
+                    }
+                    else {
+                        reply.status = StatusCode::Ok;
+                        reply.streamId = stream->getId();
+                        reply.sharedMemoryBytes = stream->getSharedMemoryBytes();
+                        stream->getSharedMemoryName().copyToUTF8(reply.sharedMemoryName, sizeof(reply.sharedMemoryName));
+                        streams[stream->getId()] = std::move(stream);
+                    }
+                }
+            }
+
+            return sendMessage(fd, MessageType::StreamOpened, &reply, sizeof(reply));
+        }
+        case MessageType::CloseStream: {
+            auto* stream = findStream(payload);
+            if (stream == nullptr)
+                return sendStatus(fd, StatusCode::UnknownStream);
+
+            streams.erase(stream->getId());
+            return sendStatus(fd, StatusCode::Ok);
+        }
+        case MessageType::SetParameter: {
+            if (payload.getSize() != sizeof(SetParameterRequest))
+                return sendStatus(fd, StatusCode::BadRequest);
+
+            auto* stream = findStream(payload);
+            if (stream == nullptr)
+                return sendStatus(fd, StatusCode::UnknownStream);
+
+            SetParameterRequest request;
+            payload.copyTo(&request, 0, sizeof(request));
+            request.parameterId[sizeof(request.parameterId) - 1] = 0;
+
+            return sendStatus(fd, stream->setParameter(juce::String::fromUTF8(request.parameterId), request.value));
+        }
+        case MessageType::SetState: {
+            auto* stream = findStream(payload);
+            if (stream == nullptr)
+                return sendStatus(fd, StatusCode::UnknownStream);
+
+            auto* blob = static_cast<const char*>(payload.getData()) + sizeof(StreamIdPayload);
+            return sendStatus(fd, stream->setState(blob, payload.getSize() - sizeof(StreamIdPayload)));
+        }
+        case MessageType::GetState: {
+            auto* stream = findStream(payload);
+            if (stream == nullptr)
+                return sendStatus(fd, StatusCode::UnknownStream);
+
+            auto state = stream->getState();
+            StreamIdPayload reply { stream->getId() };
+            return sendMessage(fd, MessageType::State, &reply, sizeof(reply), state.getData(), state.getSize());
+        }
+        default:
+            return sendStatus(fd, StatusCode::BadRequest);
+        }
+    }
+
+    EQService& owner;
+    const int fd;
+    std::map<uint32_t, std::unique_ptr<ServiceStream>> streams;
+    std::atomic<bool> finished { false };
+};
+
+//==============================================================================
+
+EQService::EQService(const juce::String& path) :
+    juce::Thread("EQ service"),
+    socketPath(path)
+{
+}
+
+EQService::~EQService() {
+    stop();
+}
+
+bool EQService::start() {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if ((size_t)socketPath.getNumBytesAsUTF8() >= sizeof(address.sun_path))
+        return false;
+    socketPath.copyToUTF8(address.sun_path, sizeof(address.sun_path));
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+        return false;
+
+    //a socket file left behind by a previous run would make bind fail
+    unlink(address.sun_path);
+
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 64) != 0) {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    startThread();
+    return true;
+}
+
+void EQService::stop() {
+    stopThread(2000);
+
+    {
+        const juce::ScopedLock lock(connectionLock);
+        connections.clear();
+    }
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+        unlink(socketPath.toRawUTF8());
+    }
+}
+
+void EQService::removeFinishedConnections() {
+    const juce::ScopedLock lock(connectionLock);
+
+    connections.erase(std::remove_if(connections.begin(), connections.end(),
+        [](const std::unique_ptr<Connection>& connection) { return connection->isFinished(); }),
+        connections.end());
+}
+
+void EQService::run() {
+    while (!threadShouldExit()) {
+        removeFinishedConnections();
+
+        pollfd request { listenFd, POLLIN, 0 };
+        if (poll(&request, 1, 100) <= 0)
+            continue;
+
+        auto fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        const juce::ScopedLock lock(connectionLock);
+        connections.push_back(std::make_unique<Connection>(*this, fd));
+    }
+}
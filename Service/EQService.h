@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    EQService.h
+    Hosts EQAudioProcessor instances for processes that can't load plugins.
+    Control over a unix socket, audio through shared-memory rings; see
+    ServiceProtocol.h for the wire format.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include "ServiceProtocol.h"
+#include "../Source/PluginProcessor.h"
+
+/*  One client stream: an EQAudioProcessor, its shared-memory region and the
+    thread that moves blocks from the input ring through processBlock() into
+    the output ring. Control calls come from the connection's thread; the
+    processor lock only keeps state restores out of a running block. */
+struct ServiceStream : private juce::Thread {
+    ServiceStream(uint32_t id, const eqservice::OpenStreamRequest& request);
+    ~ServiceStream() override;
+
+    //false when the shared memory couldn't be set up
+    bool isValid() const { return header != nullptr; }
+
+    uint32_t getId() const { return id; }
+    const juce::String& getSharedMemoryName() const { return sharedMemoryName; }
+    size_t getSharedMemoryBytes() const { return sharedMemoryBytes; }
+
+    eqservice::StatusCode setParameter(const juce::String& parameterId, float value);
+    eqservice::StatusCode setState(const void* data, size_t size);
+    juce::MemoryBlock getState();
+private:
+    void run() override;
+
+    const uint32_t id;
+    juce::String sharedMemoryName;
+    size_t sharedMemoryBytes = 0;
+    int sharedMemoryFd = -1;
+
+    eqservice::StreamHeader* header = nullptr;
+    float* inputRing = nullptr;
+    float* outputRing = nullptr;
+
+    EQAudioProcessor processor;
+    juce::CriticalSection processLock;
+    juce::AudioBuffer<float> blockBuffer;
+};
+
+/*  Accepts control connections on a unix socket. Each connection gets a
+    thread and owns the streams it opened; they close with it, so a crashed
+    client can't leak processors or shared memory. */
+struct EQService : private juce::Thread {
+    explicit EQService(const juce::String& socketPath);
+    ~EQService() override;
+
+    bool start();
+    void stop();
+
+    //a bound above which a client is assumed broken rather than chatty
+    static constexpr uint32_t maxMessageBytes = 16 << 20;
+    static constexpr uint32_t maxStreamsPerConnection = 256;
+private:
+    struct Connection;
+
+    void run() override;
+    void removeFinishedConnections();
+
+    juce::String socketPath;
+    int listenFd = -1;
+
+    juce::CriticalSection connectionLock;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::atomic<uint32_t> nextStreamId { 1 };
+};
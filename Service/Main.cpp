@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Entry point of the EQ service: eq-service [socket path]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <csignal>
+#include <cstdio>
+#include <pthread.h>
+#include <thread>
+#include "EQService.h"
+
+int main(int argc, char* argv[]) {
+    //blocked before any thread starts, so only the waiter below sees them
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    //the processors' parameter state posts to the message thread, so this one runs it
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    EQService service(argc > 1 ? juce::String(argv[1]) : juce::String(eqservice::defaultSocketPath));
+    if (!service.start()) {
+        std::fprintf(stderr, "eq-service: couldn't listen on %s\n", argc > 1 ? argv[1] : eqservice::defaultSocketPath);
+        return 1;
+    }
+
+    std::thread signalWaiter([&stopSignals] {
+        int signal = 0;
+        sigwait(&stopSignals, &signal);
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    });
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+
+    service.stop();
+    signalWaiter.join();
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    ServiceProtocol.h
+    Wire format shared by the EQ service and its clients: control messages
+    over a local socket, audio through shared-memory rings. Plain C++17 and
+    POSIX, no JUCE, so clients in any language can mirror it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace eqservice {
+
+constexpr const char* defaultSocketPath = "/tmp/eq-service.sock";
+constexpr uint32_t protocolVersion = 1;
+
+/*  Control: every message on the socket is a MessageHeader followed by
+    'size' bytes of payload. Each request gets exactly one reply, in order:
+    StreamOpened for OpenStream (its status says whether it worked), State
+    for a GetState that succeeded, Status for the rest and for failures.
+    All integers are little-endian, as on the host. */
+enum class MessageType : uint32_t {
+    OpenStream = 1,
+    CloseStream,
+    SetParameter,
+    SetState,
+    GetState,
+
+    StreamOpened = 100,
+    State,
+    Status
+};
+
+enum class StatusCode : uint32_t {
+    Ok = 0,
+    BadRequest,
+    UnknownStream,
+    UnknownParameter,
+    InvalidState,
+    OutOfResources
+};
+
+struct MessageHeader {
+    MessageType type;
+    uint32_t size;
+};
+
+struct OpenStreamRequest {
+    double sampleRate;
+    //the most frames the service processes per block, and the ring size in
+    //frames (a power of two, at least twice maxBlockFrames)
+    uint32_t maxBlockFrames;
+    uint32_t ringFrames;
+};
+
+struct StreamOpenedReply {
+    StatusCode status;
+    uint32_t streamId;
+    //for shm_open(); the service unlinks it when the stream closes
+    char sharedMemoryName[64];
+    uint64_t sharedMemoryBytes;
+};
+
+struct CloseStreamRequest {
+    uint32_t streamId;
+};
+
+//value in the parameter's own units (Hz, dB, choice index, 0/1)
+struct SetParameterRequest {
+    uint32_t streamId;
+    char parameterId[48];
+    float value;
+};
+
+//SetState: StreamIdPayload then the blob; State replies: StreamIdPayload,
+//then the blob in the plugin's getStateInformation() format
+struct StreamIdPayload {
+    uint32_t streamId;
+};
+
+struct StatusReply {
+    StatusCode status;
+};
+
+/*  Audio: one shared-memory region per stream, a StreamHeader and then the
+    input and output rings, each ringFrames stereo frames, interleaved
+    float32. The positions only ever grow (frames written or read since the
+    stream opened) and wrap by masking, so each ring is single-producer
+    single-consumer without locks: the client writes input and reads output,
+    the service the other way round.
+
+    The sequence words are futex doorbells. The client rings serviceSequence
+    after writing input or reading output, the service rings clientSequence
+    after writing output, and either side waits on its own when it has
+    nothing to do. Each stream has its own service thread, so a client that
+    stops reading only stalls its own stream. */
+constexpr uint32_t streamMagic = 0x45515331; // "EQS1"
+constexpr uint32_t numStreamChannels = 2;
+
+struct alignas(64) StreamHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numChannels;
+    uint32_t ringFrames;
+    uint32_t maxBlockFrames;
+    double sampleRate;
+
+    //set by the service when it stops serving the stream
+    std::atomic<uint32_t> closed;
+
+    alignas(64) std::atomic<uint64_t> inputWritePosition;
+    alignas(64) std::atomic<uint64_t> inputReadPosition;
+    alignas(64) std::atomic<uint64_t> outputWritePosition;
+    alignas(64) std::atomic<uint64_t> outputReadPosition;
+
+    alignas(64) std::atomic<uint32_t> serviceSequence;
+    alignas(64) std::atomic<uint32_t> clientSequence;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the rings need lock-free 64-bit positions");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit");
+
+inline size_t getRingOffset(bool output, uint32_t ringFrames) {
+    return sizeof(StreamHeader) + (output ? (size_t)ringFrames * numStreamChannels * sizeof(float) : 0);
+}
+
+inline size_t getSharedMemoryBytes(uint32_t ringFrames) {
+    return getRingOffset(true, ringFrames) + (size_t)ringFrames * numStreamChannels * sizeof(float);
+}
+
+//shared (not private) futexes, since the word lives in memory mapped by two processes
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, long timeoutNanoseconds) {
+    timespec timeout { timeoutNanoseconds / 1000000000L, timeoutNanoseconds % 1000000000L };
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+inline void futexWakeAll(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+//after publishing a position: bump the doorbell so a waiter's expected value is stale, then wake it
+inline void notify(std::atomic<uint32_t>& sequence) {
+    sequence.fetch_add(1, std::memory_order_release);
+    futexWakeAll(sequence);
+}
+
+}
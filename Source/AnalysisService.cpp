@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    AnalysisService.cpp
+    Process-wide analyzer back end shared by every editor instance.
+
+  ==============================================================================
+*/
+
+#include "AnalysisService.h"
+#include "Trace.h"
+
+AnalysisService::AnalysisService() : juce::Thread("Analysis Service") {
+    startThread();
+}
+
+AnalysisService::~AnalysisService() {
+    stopThread(1000);
+    workers.removeAllJobs(true, 1000);
+}
+
+void AnalysisService::addClient(Client* client) {
+    const juce::ScopedLock sl(clientLock);
+    client->lastServedTick = tick;
+    clients.addIfNotAlreadyThere(client);
+    candidates.ensureStorageAllocated(clients.size());
+}
+
+void AnalysisService::removeClient(Client* client) {
+    {
+        //jobs are only admitted while holding clientLock, so once the client
+        //is gone from the list no new job can start for it
+        const juce::ScopedLock sl(clientLock);
+        clients.removeFirstMatchingValue(client);
+    }
+
+    while (client->busy.load())
+        juce::Thread::sleep(1);
+}
+
+void AnalysisService::pauseClient(Client* client) {
+    {
+        const juce::ScopedLock sl(clientLock);
+        client->visible.store(false);
+    }
+
+    while (client->busy.load())
+        juce::Thread::sleep(1);
+}
+
+juce::dsp::FFT& AnalysisService::getFFT(int order) {
+    const juce::ScopedLock sl(planLock);
+
+    auto& fft = ffts[order];
+    if (fft == nullptr)
+        fft = std::make_unique<juce::dsp::FFT>(order);
+
+    return *fft;
+}
+
+juce::dsp::WindowingFunction<float>& AnalysisService::getWindow(int size) {
+    const juce::ScopedLock sl(planLock);
+
+    auto& window = windows[size];
+    if (window == nullptr)
+        window = std::make_unique<juce::dsp::WindowingFunction<float>>(size, juce::dsp::WindowingFunction<float>::blackmanHarris);
+
+    return *window;
+}
+
+void AnalysisService::run() {
+    const auto tickMs = 1000 / tickRateHz;
+
+    while (!threadShouldExit()) {
+        auto start = juce::Time::getMillisecondCounter();
+
+        scheduleTick();
+
+        auto elapsed = (int)(juce::Time::getMillisecondCounter() - start);
+        wait(juce::jmax(1, tickMs - elapsed));
+    }
+}
+
+void AnalysisService::scheduleTick() {
+    const juce::ScopedLock sl(clientLock);
+    ++tick;
+
+    candidates.clearQuick();
+    for (auto* client : clients) {
+        //a client still busy from an earlier tick simply loses this turn
+        if (client->visible.load() && !client->busy.load())
+            candidates.add(client);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Client* a, const Client* b) {
+        auto pa = a->priority.load();
+        auto pb = b->priority.load();
+        if (pa != pb)
+            return pa > pb;
+        return a->lastServedTick < b->lastServedTick;
+    });
+
+    auto numJobs = juce::jmin(candidates.size(), maxJobsPerTick);
+    for (int i = 0; i < numJobs; ++i) {
+        auto* client = candidates.getUnchecked(i);
+        client->busy.store(true);
+        client->lastServedTick = tick;
+
+        workers.addJob([client]() {
+            EQ_TRACE_THREAD_NAME("Analysis worker");
+            client->runAnalysis();
+            client->busy.store(false);
+        });
+    }
+}
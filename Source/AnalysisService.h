@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    AnalysisService.h
+    Process-wide analyzer back end shared by every editor instance.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <map>
+
+/*  One instance per process (held through juce::SharedResourcePointer).
+    Owns a small worker pool, one FFT plan per order and one window table per
+    size. Every tick, visible clients are served highest priority first and,
+    within a priority, least recently served first. At most maxJobsPerTick jobs
+    are admitted per tick, so the analyzer load stays bounded no matter how many
+    editors are open. */
+struct AnalysisService : private juce::Thread {
+    enum Priority {
+        Background,
+        Normal,
+        Foreground
+    };
+
+    struct Client {
+        virtual ~Client() = default;
+
+        //called on a worker thread, never concurrently for the same client
+        virtual void runAnalysis() = 0;
+
+        //called on the message thread, the workers can't query components
+        void setAnalysisState(bool isVisible, Priority newPriority) {
+            visible.store(isVisible);
+            priority.store(newPriority);
+        }
+    private:
+        friend struct AnalysisService;
+        std::atomic<bool> visible { false }, busy { false };
+        std::atomic<int> priority { Priority::Normal };
+        juce::uint32 lastServedTick = 0;
+    };
+
+    AnalysisService();
+    ~AnalysisService() override;
+
+    void addClient(Client* client);
+    //blocks until the client's running job (if any) has finished
+    void removeClient(Client* client);
+    //hides the client and blocks the same way, it stays registered and
+    //resumes with its next setAnalysisState(true, ...)
+    void pauseClient(Client* client);
+
+    //plans are created on first use and shared until the service goes away
+    juce::dsp::FFT& getFFT(int order);
+    juce::dsp::WindowingFunction<float>& getWindow(int size);
+
+    static constexpr int numWorkers = 2;
+    static constexpr int tickRateHz = 60;
+    static constexpr int maxJobsPerTick = 8;
+private:
+    void run() override;
+    void scheduleTick();
+
+    juce::ThreadPool workers { numWorkers };
+
+    juce::CriticalSection clientLock;
+    juce::Array<Client*> clients, candidates;
+    juce::uint32 tick = 0;
+
+    juce::CriticalSection planLock;
+    std::map<int, std::unique_ptr<juce::dsp::FFT>> ffts;
+    std::map<int, std::unique_ptr<juce::dsp::WindowingFunction<float>>> windows;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisService)
+};
@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+    Crossover.cpp
+    Linkwitz-Riley band splitter feeding the plugin's band output buses.
+
+  ==============================================================================
+*/
+
+#include "Crossover.h"
+
+void Crossover::prepare(double newSampleRate, int maximumBlockSize) {
+    sampleRate = newSampleRate;
+
+    scratch.setSize(NumScratchChannels, juce::jmax(1, maximumBlockSize));
+    scratch.clear();
+
+    //the next setSettings() has to reclamp against the new rate
+    requested.numBands = 0;
+    design();
+    reset();
+}
+
+void Crossover::reset() {
+    firstStage.reset();
+    secondStage.reset();
+}
+
+void Crossover::setSettings(const CrossoverSettings& newSettings) {
+    if (newSettings == requested)
+        return;
+
+    requested = newSettings;
+
+    auto sanitised = newSettings;
+    sanitised.numBands = juce::jlimit(2, maxBands, sanitised.numBands);
+    sanitised.butterworthOrder = juce::jlimit(1, 4, sanitised.butterworthOrder);
+
+    //split points must rise and stay clear of nyquist, where the prewarp blows up
+    auto numPoints = sanitised.numBands - 1;
+    for (int i = 0; i < numPoints; ++i)
+        sanitised.frequencies[i] = juce::jlimit(10.f, float(sampleRate * 0.45), sanitised.frequencies[i]);
+    std::sort(sanitised.frequencies.begin(), sanitised.frequencies.begin() + numPoints);
+
+    //a new topology rewires the lanes, so their state no longer belongs to them
+    auto topologyChanged = sanitised.numBands != settings.numBands || sanitised.butterworthOrder != settings.butterworthOrder;
+
+    settings = sanitised;
+    design();
+
+    if (topologyChanged)
+        reset();
+}
+
+int Crossover::designLane(SectionCoefficients* sections, float frequency, bool isHighpass, std::initializer_list<float> allpassFrequencies) const {
+    auto order = settings.butterworthOrder;
+    auto numSections = designButterworthSections(frequency, sampleRate, order, isHighpass, sections);
+
+    //running the Butterworth twice makes it Linkwitz-Riley
+    std::copy(sections, sections + numSections, sections + numSections);
+    numSections *= 2;
+
+    //odd orders only sum to an allpass with the high side inverted
+    if (isHighpass && order % 2 == 1) {
+        for (int i = 0; i < 3; ++i)
+            sections[0][i] = -sections[0][i];
+    }
+
+    for (auto allpassFrequency : allpassFrequencies) {
+        SectionCoefficients prototype[4];
+        auto numPrototypeSections = designButterworthSections(allpassFrequency, sampleRate, order, false, prototype);
+
+        for (int i = 0; i < numPrototypeSections; ++i)
+            sections[numSections++] = makeAllpassSection(prototype[i]);
+    }
+
+    return numSections;
+}
+
+void Crossover::design() {
+    if (sampleRate <= 0.0)
+        return;
+
+    SectionCoefficients sections[BandKernel<4>::maxSections];
+    auto& f = settings.frequencies;
+
+    //left channel lanes come first, the right channel repeats them
+    auto setFirst = [&](int lane, float frequency, bool isHighpass, std::initializer_list<float> allpassFrequencies) {
+        auto numSections = designLane(sections, frequency, isHighpass, allpassFrequencies);
+        firstStage.setLane(lane, sections, numSections);
+        firstStage.setLane(lane + 2, sections, numSections);
+    };
+    auto setSecond = [&](int lane, float frequency, bool isHighpass) {
+        auto numSections = designLane(sections, frequency, isHighpass, {});
+        secondStage.setLane(lane, sections, numSections);
+        secondStage.setLane(lane + 4, sections, numSections);
+    };
+    auto clearSecond = [&](int lane) {
+        secondStage.setLane(lane, nullptr, 0);
+        secondStage.setLane(lane + 4, nullptr, 0);
+    };
+
+    switch (settings.numBands) {
+    case 2:
+        setFirst(0, f[0], false, {});
+        setFirst(1, f[0], true, {});
+        for (int lane = 0; lane < 4; ++lane)
+            clearSecond(lane);
+        break;
+    case 3:
+        //band 1 is final after the first split, it only needs the upper point's allpass
+        setFirst(0, f[0], false, { f[1] });
+        setFirst(1, f[0], true, {});
+        setSecond(0, f[1], false);
+        setSecond(1, f[1], true);
+        clearSecond(2);
+        clearSecond(3);
+        break;
+    case 4:
+    default:
+        setFirst(0, f[1], false, { f[2] });
+        setFirst(1, f[1], true, { f[0] });
+        setSecond(0, f[0], false);
+        setSecond(1, f[0], true);
+        setSecond(2, f[2], false);
+        setSecond(3, f[2], true);
+        break;
+    }
+
+    decayDirty = true;
+}
+
+void Crossover::process(const juce::AudioBuffer<float>& input, const BandPointers& bands, int numSamples) {
+    jassert(input.getNumChannels() >= 2);
+
+    auto chunkSize = scratch.getNumSamples();
+    for (int offset = 0; offset < numSamples; offset += chunkSize) {
+        processChunk(input.getReadPointer(0, offset), input.getReadPointer(1, offset),
+            bands, offset, juce::jmin(chunkSize, numSamples - offset));
+    }
+}
+
+void Crossover::processChunk(const float* left, const float* right, const BandPointers& bands, int offset, int numSamples) {
+    auto* silence = scratch.getReadPointer(Silence);
+    auto* discard = scratch.getWritePointer(Discard);
+
+    auto band = [&](int index, int channel) {
+        auto* destination = bands[index][channel];
+        return destination != nullptr ? destination + offset : discard;
+    };
+
+    auto* lowLeft = scratch.getWritePointer(LowLeft);
+    auto* lowRight = scratch.getWritePointer(LowRight);
+    auto* highLeft = scratch.getWritePointer(HighLeft);
+    auto* highRight = scratch.getWritePointer(HighRight);
+
+    switch (settings.numBands) {
+    case 2:
+        firstStage.process({ left, left, right, right },
+            { band(0, 0), band(1, 0), band(0, 1), band(1, 1) }, numSamples);
+        break;
+    case 3:
+        firstStage.process({ left, left, right, right },
+            { band(0, 0), highLeft, band(0, 1), highRight }, numSamples);
+        secondStage.process({ highLeft, highLeft, silence, silence, highRight, highRight, silence, silence },
+            { band(1, 0), band(2, 0), discard, discard, band(1, 1), band(2, 1), discard, discard }, numSamples);
+        break;
+    case 4:
+    default:
+        firstStage.process({ left, left, right, right },
+            { lowLeft, highLeft, lowRight, highRight }, numSamples);
+        secondStage.process({ lowLeft, lowLeft, highLeft, highLeft, lowRight, lowRight, highRight, highRight },
+            { band(0, 0), band(1, 0), band(2, 0), band(3, 0), band(0, 1), band(1, 1), band(2, 1), band(3, 1) }, numSamples);
+        break;
+    }
+}
+
+double Crossover::getDecaySamples(double decayGain) const {
+    if (decayDirty || decayGain != cachedDecayGain) {
+        cachedDecaySamples = firstStage.getDecaySamples(decayGain);
+        if (settings.numBands > 2)
+            cachedDecaySamples += secondStage.getDecaySamples(decayGain);
+
+        cachedDecayGain = decayGain;
+        decayDirty = false;
+    }
+
+    return cachedDecaySamples;
+}
@@ -0,0 +1,166 @@
+/*
+  ==============================================================================
+
+    Crossover.h
+    Linkwitz-Riley band splitter feeding the plugin's band output buses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "SectionDesign.h"
+
+/*  A cascade of biquad sections run on several independent signals ("lanes")
+    at once. The coefficients and state are stored lane-innermost, so every
+    section update is one loop over contiguous lanes that the compiler turns
+    into vector instructions. Sections a lane doesn't use stay identity. */
+template<int NumLanes>
+struct BandKernel {
+    static constexpr int numLanes = NumLanes;
+    static constexpr int maxSections = 6;
+
+    BandKernel() {
+        for (int lane = 0; lane < numLanes; ++lane)
+            setLane(lane, nullptr, 0);
+    }
+
+    void setLane(int lane, const SectionCoefficients* sections, int numSectionsInLane) {
+        jassert(numSectionsInLane <= maxSections);
+
+        for (int s = 0; s < maxSections; ++s) {
+            SectionCoefficients c { 1.f, 0.f, 0.f, 0.f, 0.f };
+            if (s < numSectionsInLane)
+                c = sections[s];
+
+            b0[s][lane] = c[0];
+            b1[s][lane] = c[1];
+            b2[s][lane] = c[2];
+            a1[s][lane] = c[3];
+            a2[s][lane] = c[4];
+        }
+
+        laneSections[lane] = numSectionsInLane;
+        numSections = 0;
+        for (auto n : laneSections)
+            numSections = juce::jmax(numSections, n);
+    }
+
+    void reset() {
+        for (int s = 0; s < maxSections; ++s) {
+            std::fill(std::begin(s1[s]), std::end(s1[s]), 0.f);
+            std::fill(std::begin(s2[s]), std::end(s2[s]), 0.f);
+        }
+    }
+
+    //transposed direct form II, as juce::dsp::IIR::Filter
+    void process(const std::array<const float*, numLanes>& inputs, const std::array<float*, numLanes>& outputs, int numSamples) {
+        alignas(16) float x[numLanes];
+
+        for (int i = 0; i < numSamples; ++i) {
+            for (int lane = 0; lane < numLanes; ++lane)
+                x[lane] = inputs[lane][i];
+
+            for (int s = 0; s < numSections; ++s) {
+                for (int lane = 0; lane < numLanes; ++lane) {
+                    auto y = b0[s][lane] * x[lane] + s1[s][lane];
+                    s1[s][lane] = b1[s][lane] * x[lane] - a1[s][lane] * y + s2[s][lane];
+                    s2[s][lane] = b2[s][lane] * x[lane] - a2[s][lane] * y;
+                    x[lane] = y;
+                }
+            }
+
+            for (int lane = 0; lane < numLanes; ++lane)
+                outputs[lane][i] = x[lane];
+        }
+    }
+
+    //the longest lane's decay, with each lane's sections summed as an upper bound
+    double getDecaySamples(double decayGain) const {
+        double longest = 0.0;
+
+        for (int lane = 0; lane < numLanes; ++lane) {
+            double samples = 0.0;
+            for (int s = 0; s < laneSections[lane]; ++s)
+                samples += getPoleDecaySamples(a1[s][lane], a2[s][lane], decayGain);
+
+            longest = juce::jmax(longest, samples);
+        }
+
+        return longest;
+    }
+private:
+    alignas(16) float b0[maxSections][numLanes], b1[maxSections][numLanes], b2[maxSections][numLanes];
+    alignas(16) float a1[maxSections][numLanes], a2[maxSections][numLanes];
+    alignas(16) float s1[maxSections][numLanes] {}, s2[maxSections][numLanes] {};
+
+    std::array<int, numLanes> laneSections {};
+    int numSections = 0;
+};
+
+struct CrossoverSettings {
+    int numBands { 2 };
+    std::array<float, 3> frequencies { 200.f, 1000.f, 5000.f };
+    int butterworthOrder { 2 };
+
+    bool operator==(const CrossoverSettings& other) const {
+        return numBands == other.numBands && frequencies == other.frequencies && butterworthOrder == other.butterworthOrder;
+    }
+    bool operator!=(const CrossoverSettings& other) const { return !(*this == other); }
+};
+
+/*  An LR crossover of order 2N is a Butterworth cut of order N run twice, so
+    each split reuses the EQ cuts' section designs (N = 1 to 4, LR2 to LR8).
+    The low and high outputs of a split sum to the allpass B(-s)/B(s) of the
+    Butterworth prototype, with the high output inverted for odd N.
+
+    The bands are split as a tree: 2 bands split once, 3 bands split at the
+    lowest point and again above it, 4 bands split in the middle and then each
+    half again. A branch gets the allpass of the split points it doesn't pass
+    through once, ahead of its own split, so the two bands it feeds share one
+    compensation filter and the bands sum back to a pure allpass.
+
+    Stage one runs both channels' first split in a 4-lane kernel, stage two
+    every remaining filter of every band in an 8-lane one. */
+struct Crossover {
+    static constexpr int maxBands = 4;
+
+    void prepare(double sampleRate, int maximumBlockSize);
+    void reset();
+
+    //call from the audio thread; redesigns only when the settings changed
+    void setSettings(const CrossoverSettings& newSettings);
+    const CrossoverSettings& getSettings() const { return settings; }
+
+    //bands[b][channel]; a band whose pointers are null is computed but discarded
+    using BandPointers = std::array<std::array<float*, 2>, maxBands>;
+    void process(const juce::AudioBuffer<float>& input, const BandPointers& bands, int numSamples);
+
+    double getDecaySamples(double decayGain) const;
+
+    size_t getAllocatedBytes() const {
+        return (size_t)scratch.getNumChannels() * (size_t)scratch.getNumSamples() * sizeof(float);
+    }
+private:
+    void design();
+    void processChunk(const float* left, const float* right, const BandPointers& bands, int offset, int numSamples);
+
+    //the LR low or high of a split, optionally followed by other points' allpasses
+    int designLane(SectionCoefficients* sections, float frequency, bool isHighpass, std::initializer_list<float> allpassFrequencies) const;
+
+    BandKernel<4> firstStage;
+    BandKernel<8> secondStage;
+
+    //requested is what the parameters asked for, settings what was designed
+    CrossoverSettings requested, settings;
+    double sampleRate = 0.0;
+
+    mutable double cachedDecaySamples = 0.0, cachedDecayGain = 0.0;
+    mutable bool decayDirty = true;
+
+    //lowL, lowR, highL, highR between the stages, plus a silent input and a discard output
+    juce::AudioBuffer<float> scratch;
+    enum ScratchChannels { LowLeft, LowRight, HighLeft, HighRight, Silence, Discard, NumScratchChannels };
+};
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    CurveRenderer.cpp
+    Column-simplified polylines and an anti-aliased span rasteriser for the
+    analyzer and response curves.
+
+  ==============================================================================
+*/
+
+#include "CurveRenderer.h"
+
+void CurveRasteriser::setSize(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        image = juce::Image();
+        return;
+    }
+
+    if (image.isValid() && image.getWidth() == width && image.getHeight() == height)
+        return;
+
+    image = juce::Image(juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+    spanTop.resize((size_t)width);
+    spanBottom.resize((size_t)width);
+}
+
+void CurveRasteriser::clear() {
+    if (image.isValid())
+        image.clear(image.getBounds());
+}
+
+void CurveRasteriser::includeSpan(int x, float top, float bottom) {
+    if (x < 0 || x >= image.getWidth() || !std::isfinite(top) || !std::isfinite(bottom))
+        return;
+
+    spanTop[x] = juce::jmin(spanTop[x], top);
+    spanBottom[x] = juce::jmax(spanBottom[x], bottom);
+    spanStart = juce::jmin(spanStart, x);
+    spanEnd = juce::jmax(spanEnd, x + 1);
+}
+
+void CurveRasteriser::drawCurve(const Polyline& curve, juce::Colour colour, float thickness, juce::Point<int> offset) {
+    using namespace juce;
+
+    if (!image.isValid() || curve.isEmpty())
+        return;
+
+    auto width = image.getWidth();
+    auto height = image.getHeight();
+
+    std::fill(spanTop.begin(), spanTop.end(), std::numeric_limits<float>::max());
+    std::fill(spanBottom.begin(), spanBottom.end(), std::numeric_limits<float>::lowest());
+    spanStart = width;
+    spanEnd = 0;
+
+    auto dy = (float)offset.getY();
+    const Polyline::Column* previous = nullptr;
+
+    for (auto& column : curve.columns) {
+        auto x = column.x + offset.getX();
+        includeSpan(x, column.min + dy, column.max + dy);
+
+        if (previous != nullptr) {
+            //join the previous column's last point to this column's first, both
+            //taken at the column centres, and split the segment per pixel column
+            auto x0 = previous->x + offset.getX();
+            auto y0 = previous->last + dy;
+            auto y1 = column.first + dy;
+            auto length = float(x - x0);
+
+            for (int k = juce::jmax(x0, 0); k <= juce::jmin(x, width - 1); ++k) {
+                auto ta = jlimit(0.f, 1.f, (float(k - x0) - 0.5f) / length);
+                auto tb = jlimit(0.f, 1.f, (float(k - x0) + 0.5f) / length);
+                auto ya = y0 + ta * (y1 - y0);
+                auto yb = y0 + tb * (y1 - y0);
+                includeSpan(k, jmin(ya, yb), jmax(ya, yb));
+            }
+        }
+
+        previous = &column;
+    }
+
+    Image::BitmapData data(image, Image::BitmapData::readWrite);
+    auto source = colour.getPixelARGB();
+    auto halfThickness = thickness * 0.5f;
+
+    for (int x = spanStart; x < spanEnd; ++x) {
+        if (spanTop[x] > spanBottom[x])
+            continue;
+
+        auto top = spanTop[x] - halfThickness;
+        auto bottom = spanBottom[x] + halfThickness;
+
+        auto firstRow = jmax(0, (int)std::floor(top));
+        auto lastRow = jmin(height - 1, (int)std::ceil(bottom) - 1);
+
+        for (int row = firstRow; row <= lastRow; ++row) {
+            //fractional coverage only matters at the two ends of the span
+            auto coverage = jmin(bottom, row + 1.f) - jmax(top, (float)row);
+            if (coverage <= 0.f)
+                continue;
+
+            auto pixel = source;
+            pixel.multiplyAlpha(jmin(255, roundToInt(coverage * 255.f)));
+            reinterpret_cast<PixelARGB*>(data.getPixelPointer(x, row))->blend(pixel);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    CurveRenderer.h
+    Column-simplified polylines and an anti-aliased span rasteriser for the
+    analyzer and response curves.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*  An x-monotone curve reduced to one entry per pixel column. Every point that
+    lands in a column is folded into that column's first/last/min/max, so the
+    drawn result stays within a pixel of the full curve while a 1024-bin
+    spectrum collapses to at most one entry per column.
+    Has the subset of the juce::Path interface AnalyzerPathGenerator uses. */
+struct Polyline {
+    struct Column {
+        int x;
+        float first, last, min, max;
+    };
+
+    void preallocateSpace(int numColumns) { columns.reserve((size_t)numColumns); }
+    void clear() { columns.clear(); }
+    bool isEmpty() const { return columns.empty(); }
+    size_t getAllocatedBytes() const { return columns.capacity() * sizeof(Column); }
+
+    void startNewSubPath(float x, float y) {
+        columns.clear();
+        lineTo(x, y);
+    }
+
+    void lineTo(float x, float y) {
+        auto column = (int)std::floor(x);
+
+        if (columns.empty() || columns.back().x != column) {
+            columns.push_back({ column, y, y, y, y });
+            return;
+        }
+
+        auto& back = columns.back();
+        back.last = y;
+        back.min = juce::jmin(back.min, y);
+        back.max = juce::jmax(back.max, y);
+    }
+
+    std::vector<Column> columns;
+};
+
+//lets Fifo<Polyline> report its memory
+inline size_t getHeapBytes(const Polyline& polyline) { return polyline.getAllocatedBytes(); }
+
+//pixel storage only, an estimate for memory reports
+inline size_t getImageBytes(const juce::Image& image) {
+    if (!image.isValid())
+        return 0;
+
+    auto bytesPerPixel = image.getFormat() == juce::Image::SingleChannel ? 1 : (image.getFormat() == juce::Image::RGB ? 3 : 4);
+    return (size_t)image.getWidth() * (size_t)image.getHeight() * (size_t)bytesPerPixel;
+}
+
+/*  Draws Polylines into a reused ARGB image. Each curve is turned into one
+    vertical span per pixel column (the column's own min/max plus the segment
+    joining it to its neighbour), widened by the line thickness and blended
+    with fractional coverage at both ends. No edge table, no Path copies. */
+struct CurveRasteriser {
+    //reallocates only when the size changes
+    void setSize(int width, int height);
+    void clear();
+
+    void drawCurve(const Polyline& curve, juce::Colour colour, float thickness, juce::Point<int> offset);
+
+    const juce::Image& getImage() const { return image; }
+    size_t getAllocatedBytes() const {
+        return getImageBytes(image) + (spanTop.capacity() + spanBottom.capacity()) * sizeof(float);
+    }
+private:
+    void includeSpan(int x, float top, float bottom);
+
+    juce::Image image;
+    std::vector<float> spanTop, spanBottom;
+    int spanStart = 0, spanEnd = 0;
+};
@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    EQCore.cpp
+    Filter designs, chain updates and EQCoreProcessor.
+
+  ==============================================================================
+*/
+
+#include "EQCore.h"
+
+Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate) {
+    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(
+        sampleRate,
+        chainSettings.peakFreq,
+        chainSettings.peakQuality,
+        juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+}
+
+//attenuation in dB of a bilinear Butterworth cut of the given order. The designs
+//prewarp the cutoff, so the digital response is the analog one evaluated at tan(pi f / fs)
+static double getButterworthAttenuationDb(double cutoff, double freq, double sampleRate, int order, bool isHighpass) {
+    auto nyquist = sampleRate * 0.5;
+    auto warp = [sampleRate, nyquist](double f) {
+        return std::tan(juce::MathConstants<double>::pi * juce::jlimit(1.0, nyquist * 0.999, f) / sampleRate);
+    };
+
+    auto ratio = isHighpass ? warp(cutoff) / warp(freq) : warp(freq) / warp(cutoff);
+    return 10.0 * std::log10(1.0 + std::pow(ratio, 2.0 * order));
+}
+
+StageActivity getAudibleStages(const ChainSettings& chainSettings, double sampleRate, const IdentityTolerance& tolerance) {
+    StageActivity activity;
+
+    //Butterworth cuts are monotonic, so the worst case sits on the band edge
+    activity.lowCut = !chainSettings.lowCutBypassed &&
+        getButterworthAttenuationDb(chainSettings.lowCutFreq, tolerance.audibleLowHz, sampleRate,
+            2 * (chainSettings.lowCutSlope + 1), true) > tolerance.maxDeviationDb;
+
+    //the peak deviates most at its centre frequency
+    activity.peak = !chainSettings.peakBypassed &&
+        std::abs(chainSettings.peakGainInDecibels) > tolerance.maxDeviationDb;
+
+    activity.highCut = !chainSettings.highCutBypassed &&
+        getButterworthAttenuationDb(chainSettings.highCutFreq, tolerance.audibleHighHz, sampleRate,
+            2 * (chainSettings.highCutSlope + 1), false) > tolerance.maxDeviationDb;
+
+    return activity;
+}
+
+void updateMonoChain(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate) {
+    chain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    chain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    chain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+
+    auto peakCoefficients = makePeakFilter(chainSettings, sampleRate);
+    updateCoefficients(chain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+
+    CutCoefficients lowCutCoefficients, highCutCoefficients;
+    designLowCutFilter(chainSettings, sampleRate, lowCutCoefficients);
+    designHighCutFilter(chainSettings, sampleRate, highCutCoefficients);
+    updateCutFilter(chain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
+    updateCutFilter(chain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+}
+
+template<typename CutType>
+static double getCutMagnitude(const CutType& cut, double frequency, double sampleRate) {
+    double mag = 1.0;
+    if (!cut.template isBypassed<0>())
+        mag *= cut.template get<0>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+    if (!cut.template isBypassed<1>())
+        mag *= cut.template get<1>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+    if (!cut.template isBypassed<2>())
+        mag *= cut.template get<2>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+    if (!cut.template isBypassed<3>())
+        mag *= cut.template get<3>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+
+    return mag;
+}
+
+double getChainMagnitude(const MonoChain& chain, double frequency, double sampleRate) {
+    double mag = 1.0;
+
+    if (!chain.isBypassed<ChainPositions::Peak>())
+        mag *= chain.get<ChainPositions::Peak>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+
+    if (!chain.isBypassed<ChainPositions::LowCut>())
+        mag *= getCutMagnitude(chain.get<ChainPositions::LowCut>(), frequency, sampleRate);
+
+    if (!chain.isBypassed<ChainPositions::HighCut>())
+        mag *= getCutMagnitude(chain.get<ChainPositions::HighCut>(), frequency, sampleRate);
+
+    return mag;
+}
+
+void updateCoefficients(Coefficients &old, const Coefficients &replacements) {
+    *old = *replacements;
+}
+
+void updateCoefficients(Coefficients& old, const SectionCoefficients& replacements) {
+    auto& coefficients = old->coefficients;
+
+    if (coefficients.size() != (int)replacements.size())
+        coefficients.resize((int)replacements.size());
+
+    std::copy(replacements.begin(), replacements.end(), coefficients.begin());
+}
+
+void EQCoreProcessor::prepare(double newSampleRate, int maximumBlockSize, int numChannels) {
+    sampleRate = newSampleRate;
+
+    chains.clear();
+    chains.resize((size_t)juce::jmax(0, numChannels));
+
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32)juce::jmax(1, maximumBlockSize), 1 };
+    for (auto& chain : chains) {
+        chain.prepare(spec);
+        updateMonoChain(chain, settings, sampleRate);
+    }
+}
+
+void EQCoreProcessor::reset() {
+    for (auto& chain : chains)
+        chain.reset();
+}
+
+void EQCoreProcessor::setSettings(const ChainSettings& newSettings) {
+    if (newSettings == settings)
+        return;
+
+    settings = newSettings;
+    for (auto& chain : chains)
+        updateMonoChain(chain, settings, sampleRate);
+}
+
+void EQCoreProcessor::process(float* const* channels, int numChannels, int numSamples) {
+    jassert(numChannels <= (int)chains.size());
+    numChannels = juce::jmin(numChannels, (int)chains.size());
+
+    juce::dsp::AudioBlock<float> block(channels, (size_t)numChannels, (size_t)numSamples);
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        auto channelBlock = block.getSingleChannelBlock((size_t)channel);
+        juce::dsp::ProcessContextReplacing<float> context(channelBlock);
+        chains[(size_t)channel].process(context);
+    }
+}
+
+void EQCoreProcessor::process(juce::AudioBuffer<float>& buffer) {
+    process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
+}
+
+double EQCoreProcessor::getMagnitudeForFrequency(double frequency) const {
+    //every channel runs the same design
+    return chains.empty() ? 1.0 : getChainMagnitude(chains.front(), frequency, sampleRate);
+}
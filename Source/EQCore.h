@@ -0,0 +1,219 @@
+/*
+  ==============================================================================
+
+    EQCore.h
+    The EQ's DSP without the plugin: settings, filter chains and their
+    designs. Needs juce_dsp and nothing above it, so it also builds as the
+    EQCore static library (Core/EQCore.jucer) for hosts that have no use for
+    the GUI, the plugin wrapper or audio devices.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <vector>
+#include "SectionDesign.h"
+#include "StateVariableFilter.h"
+
+enum Slope {
+    Slope_12,
+    Slope_24,
+    Slope_36,
+    Slope_48
+};
+
+struct ChainSettings {
+    float peakFreq { 0 }, peakGainInDecibels { 0 }, peakQuality { 1.f };
+    float lowCutFreq { 0 }, highCutFreq { 0 };
+    Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
+
+    bool lowCutBypassed{ false }, peakBypassed{ false }, highCutBypassed{ false };
+
+    bool operator==(const ChainSettings& other) const {
+        return peakFreq == other.peakFreq && peakGainInDecibels == other.peakGainInDecibels && peakQuality == other.peakQuality
+            && lowCutFreq == other.lowCutFreq && highCutFreq == other.highCutFreq
+            && lowCutSlope == other.lowCutSlope && highCutSlope == other.highCutSlope
+            && lowCutBypassed == other.lowCutBypassed && peakBypassed == other.peakBypassed && highCutBypassed == other.highCutBypassed;
+    }
+    bool operator!=(const ChainSettings& other) const { return !(*this == other); }
+};
+
+//the parameters' defaults; PluginProcessor.cpp checks them against Parameters.h
+constexpr ChainSettings getDefaultChainSettings() {
+    ChainSettings settings;
+    settings.lowCutFreq = 20.f;
+    settings.highCutFreq = 20000.f;
+    settings.peakFreq = 750.f;
+    return settings;
+}
+
+using Filter = juce::dsp::IIR::Filter<float>;
+using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+
+enum ChainPositions {
+    LowCut,
+    Peak,
+    HighCut
+};
+
+inline const char* getChainPositionName(int position) {
+    switch (position) {
+    case LowCut: return "LowCut";
+    case Peak: return "Peak";
+    case HighCut: return "HighCut";
+    default: return "Unknown";
+    }
+}
+
+//what the peak and cut stages run on, in the order of the Filter Backend choices
+enum class FilterBackend {
+    //juce::dsp::IIR direct-form biquads
+    Biquad,
+    //TPT state-variable sections, cheap and safe to modulate per sample
+    StateVariable
+};
+
+//the state-variable backend's counterpart of MonoChain, in ChainPositions order
+using SvfCut = SvfCascade<4>;
+
+struct SvfChain {
+    SvfCut lowCut;
+    SvfCascade<1> peak;
+    SvfCut highCut;
+
+    template<int Position>
+    auto& get() {
+        if constexpr (Position == ChainPositions::LowCut)
+            return lowCut;
+        else if constexpr (Position == ChainPositions::Peak)
+            return peak;
+        else
+            return highCut;
+    }
+
+    void reset() {
+        lowCut.reset();
+        peak.reset();
+        highCut.reset();
+    }
+
+    //the next setSections() starts every section afresh
+    void clear() {
+        lowCut.clear();
+        peak.clear();
+        highCut.clear();
+    }
+};
+
+using Coefficients = Filter::CoefficientsPtr;
+void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+
+using CutCoefficients = std::array<SectionCoefficients, 4>;
+
+//writes straight into the existing coefficients object, no allocation once it holds a biquad
+void updateCoefficients(Coefficients& old, const SectionCoefficients& replacements);
+Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
+
+template<int Index, typename ChainType, typename CoefficientType>
+void update(ChainType& chain, const CoefficientType& coefficients) {
+    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
+    chain.template setBypassed<Index>(false);
+}
+
+template <typename ChainType, typename CoefficientType>
+void updateCutFilter(ChainType& chain, const CoefficientType& coefficients, const Slope& slope) {
+
+    chain.template setBypassed<0>(true);
+    chain.template setBypassed<1>(true);
+    chain.template setBypassed<2>(true);
+    chain.template setBypassed<3>(true);
+
+    switch (slope) {
+    case Slope_48:
+        update<3>(chain, coefficients);
+    case Slope_36:
+        update<2>(chain, coefficients);
+    case Slope_24:
+        update<1>(chain, coefficients);
+    case Slope_12:
+        update<0>(chain, coefficients);
+        break;
+    default:
+        break;
+    }
+}
+
+//the chain the response curve draws; reference matching fits against the same model
+void updateMonoChain(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate);
+//linear magnitude of 'chain' at 'frequency', leaving out bypassed stages and sections
+double getChainMagnitude(const MonoChain& chain, double frequency, double sampleRate);
+
+//a stage counts as identity when its worst-case deviation inside the audible
+//band stays within maxDeviationDb (bypassed stages are always identity)
+struct IdentityTolerance {
+    float maxDeviationDb { 1.f };
+    float audibleLowHz { 30.f }, audibleHighHz { 15000.f };
+};
+
+struct StageActivity {
+    bool lowCut { true }, peak { true }, highCut { true };
+
+    bool any() const { return lowCut || peak || highCut; }
+};
+
+StageActivity getAudibleStages(const ChainSettings& chainSettings, double sampleRate, const IdentityTolerance& tolerance);
+
+//the cuts' Butterworth designs, written into caller-owned storage without allocating
+inline void designButterworthCut(float frequency, double sampleRate, Slope slope, bool isHighpass, CutCoefficients& sections) {
+    designButterworthSections(frequency, sampleRate, 2 * (slope + 1), isHighpass, sections.data());
+}
+
+inline void designLowCutFilter(const ChainSettings& chainSettings, double sampleRate, CutCoefficients& sections) {
+    designButterworthCut(chainSettings.lowCutFreq, sampleRate, chainSettings.lowCutSlope, true, sections);
+}
+inline void designHighCutFilter(const ChainSettings& chainSettings, double sampleRate, CutCoefficients& sections) {
+    designButterworthCut(chainSettings.highCutFreq, sampleRate, chainSettings.highCutSlope, false, sections);
+}
+
+//reference designs through juce::dsp::FilterDesign, these allocate
+inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate) {
+    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(
+        chainSettings.lowCutFreq,
+        sampleRate,
+        2 * (chainSettings.lowCutSlope + 1));
+}
+inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate) {
+    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(
+        chainSettings.highCutFreq,
+        sampleRate,
+        2 * (chainSettings.highCutSlope + 1));
+}
+
+/*  The EQ as a plain DSP object for hosts without an AudioProcessor: one
+    MonoChain per channel on the biquad backend, redesigned when setSettings()
+    gets different settings. Changes apply at the next block with no
+    smoothing, and there is no oversampling, crossover or auto-gain; those
+    stay in the plugin. */
+struct EQCoreProcessor {
+    //allocates; the settings are kept and designed for the new rate
+    void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+    void reset();
+
+    void setSettings(const ChainSettings& newSettings);
+    const ChainSettings& getSettings() const { return settings; }
+
+    //filters numChannels (at most the prepared count) channels in place
+    void process(float* const* channels, int numChannels, int numSamples);
+    void process(juce::AudioBuffer<float>& buffer);
+
+    //linear magnitude of the current settings at 'frequency'
+    double getMagnitudeForFrequency(double frequency) const;
+private:
+    std::vector<MonoChain> chains;
+    ChainSettings settings = getDefaultChainSettings();
+    double sampleRate = 44100.0;
+};
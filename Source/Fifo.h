@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    Fifo.h
+    Lock-free single producer / single consumer hand-off used between the
+    audio thread, the analysis workers and the message thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+//heap bytes held by a fifo slot, for memory reports. Types without an overload count as none
+template<typename T>
+size_t getHeapBytes(const T&) { return 0; }
+
+inline size_t getHeapBytes(const juce::AudioBuffer<float>& buffer) {
+    return (size_t)buffer.getNumChannels() * (size_t)buffer.getNumSamples() * sizeof(float);
+}
+
+inline size_t getHeapBytes(const std::vector<float>& vector) {
+    return vector.capacity() * sizeof(float);
+}
+
+/*  push()/pull() copy-assign, which deep-copies buffers, vectors and paths.
+    pushSwap()/pullSwap() exchange the caller's object with the slot instead:
+    the caller leaves with whatever the slot held before, so the same few
+    objects circulate and their storage is reused. Producers that write into
+    their object by index need it to keep its shape, so consumers should only
+    swap objects shaped like the ones being pushed.
+
+    A full fifo drops the push; the drops are counted so a consumer falling
+    behind shows up. One slot of AbstractFifo is always kept free, so at most
+    Capacity - 1 objects are in flight. */
+template<typename T, int Capacity = 30>
+struct Fifo {
+    static_assert(Capacity >= 2, "a Fifo needs at least two slots");
+
+    void prepare(int numChannels, int numSamples) {
+        static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,  
+            "prepare(numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
+        for (auto& buffer : buffers) {
+            buffer.setSize(numChannels,
+                numSamples,
+                false,
+                true,
+                true);
+            buffer.clear();
+        }
+    }
+
+    void prepare(size_t numElements) {
+        static_assert(std::is_same_v<T, std::vector<float>>,
+            "prepare(numElements) should only be used when the Fifo is holding std::vector<float>");
+        for (auto& buffer : buffers) {
+            buffer.clear();
+            buffer.resize(numElements, 0);
+        }
+    }
+
+    bool push(const T& t) {
+        auto write = fifo.write(1);
+
+        if (write.blockSize1 > 0) {
+            buffers[write.startIndex1] = t;
+            return true;
+        }
+
+        droppedPushes.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool pull(T& t) {
+        auto read = fifo.read(1);
+
+        if (read.blockSize1 > 0) {
+            t = buffers[read.startIndex1];
+            return true;
+        }
+
+        return false;
+    }
+
+    //'t' comes back holding the slot's previous object, unless the push was dropped
+    bool pushSwap(T& t) {
+        auto write = fifo.write(1);
+
+        if (write.blockSize1 > 0) {
+            std::swap(buffers[write.startIndex1], t);
+            return true;
+        }
+
+        droppedPushes.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    //the slot keeps 't's old object for a later pushSwap() to hand back
+    bool pullSwap(T& t) {
+        auto read = fifo.read(1);
+
+        if (read.blockSize1 > 0) {
+            std::swap(buffers[read.startIndex1], t);
+            return true;
+        }
+
+        return false;
+    }
+
+    int getNumAvailableForReading() const {
+        return fifo.getNumReady();
+    }
+
+    //frees every slot and empties the fifo; neither side may be using it meanwhile
+    void release() {
+        for (auto& buffer : buffers)
+            buffer = T();
+
+        fifo.reset();
+    }
+
+    size_t getAllocatedBytes() const {
+        size_t bytes = 0;
+        for (auto& buffer : buffers)
+            bytes += getHeapBytes(buffer);
+
+        return bytes;
+    }
+
+    static constexpr int getCapacity() { return Capacity; }
+
+    //pushes dropped because the fifo was full, since construction
+    int getNumDroppedPushes() const { return droppedPushes.load(std::memory_order_relaxed); }
+private:
+    std::array<T, Capacity> buffers;
+    juce::AbstractFifo fifo{ Capacity };
+    std::atomic<int> droppedPushes { 0 };
+};
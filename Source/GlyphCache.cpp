@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+
+    GlyphCache.cpp
+    Process-wide cache of laid-out glyphs for the editor's fixed labels.
+
+  ==============================================================================
+*/
+
+#include "GlyphCache.h"
+
+float GlyphCache::getWidth(const juce::String& text, float fontHeight) {
+    return getEntry(text, fontHeight).width;
+}
+
+void GlyphCache::draw(juce::Graphics& g, const juce::String& text, float fontHeight,
+    juce::Rectangle<float> area, juce::Justification justification) {
+    auto& entry = getEntry(text, fontHeight);
+
+    auto placed = justification.appliedToRectangle(juce::Rectangle<float>(entry.width, entry.height), area);
+    entry.glyphs.draw(g, juce::AffineTransform::translation(placed.getX(), placed.getY()));
+}
+
+const GlyphCache::Entry& GlyphCache::getEntry(const juce::String& text, float fontHeight) {
+    auto key = std::make_pair(fontHeight, text);
+
+    auto found = entries.find(key);
+    if (found != entries.end())
+        return found->second;
+
+    juce::Font font(fontHeight);
+
+    Entry entry;
+    entry.width = font.getStringWidthFloat(text);
+    entry.height = font.getHeight();
+    //top-left at the origin, draw() only has to translate it
+    entry.glyphs.addLineOfText(font, text, 0.f, font.getAscent());
+
+    return entries.emplace(key, std::move(entry)).first->second;
+}
@@ -0,0 +1,37 @@
+/*
+  ==============================================================================
+
+    GlyphCache.h
+    Process-wide cache of laid-out glyphs for the editor's fixed labels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <utility>
+
+/*  One instance per process (held through juce::SharedResourcePointer), used
+    from the message thread only. Each label is shaped once, the first time
+    any editor draws it, and every later draw in every editor just blits the
+    stored glyphs. Meant for the small fixed set of scale and section labels;
+    text that changes with a value (the knob readouts) shouldn't go through it. */
+struct GlyphCache {
+    //width of 'text' at 'fontHeight', shaping it if it isn't cached yet
+    float getWidth(const juce::String& text, float fontHeight);
+
+    //same placement as drawFittedText() for a single line that fits 'area'
+    void draw(juce::Graphics& g, const juce::String& text, float fontHeight,
+        juce::Rectangle<float> area, juce::Justification justification);
+private:
+    struct Entry {
+        juce::GlyphArrangement glyphs;
+        float width = 0.f, height = 0.f;
+    };
+
+    const Entry& getEntry(const juce::String& text, float fontHeight);
+
+    std::map<std::pair<float, juce::String>, Entry> entries;
+};
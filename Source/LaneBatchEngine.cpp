@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    LaneBatchEngine.cpp
+    Offline engine running one set of EQ settings over many mono signals at
+    once, one signal per SIMD lane.
+
+  ==============================================================================
+*/
+
+#include "LaneBatchEngine.h"
+
+//the wider kernels are compiled for their instruction set per function, so
+//the rest of the plugin keeps the baseline target. MSVC can't do that and
+//stays on its baseline vectorisation
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define EQ_LANE_BATCH_TARGETS 1
+ #define EQ_LANE_BATCH_TARGET(isa) __attribute__((target(isa)))
+#else
+ #define EQ_LANE_BATCH_TARGETS 0
+ #define EQ_LANE_BATCH_TARGET(isa)
+#endif
+
+namespace {
+
+//state comes in and goes out through locals so the lane loops see no aliasing
+template<int NumLanes>
+forcedinline void processLanes(const SectionCoefficients* sections, int numSections, float* state,
+    float* const* lanes, int numSamples)
+{
+    alignas(64) float s1[LaneBatchEngine::maxSections][NumLanes];
+    alignas(64) float s2[LaneBatchEngine::maxSections][NumLanes];
+    alignas(64) float x[NumLanes];
+
+    for (int s = 0; s < numSections; ++s) {
+        std::copy(state + (s * 2) * NumLanes, state + (s * 2 + 1) * NumLanes, s1[s]);
+        std::copy(state + (s * 2 + 1) * NumLanes, state + (s * 2 + 2) * NumLanes, s2[s]);
+    }
+
+    for (int i = 0; i < numSamples; ++i) {
+        for (int lane = 0; lane < NumLanes; ++lane)
+            x[lane] = lanes[lane][i];
+
+        for (int s = 0; s < numSections; ++s) {
+            auto b0 = sections[s][0], b1 = sections[s][1], b2 = sections[s][2];
+            auto a1 = sections[s][3], a2 = sections[s][4];
+
+            for (int lane = 0; lane < NumLanes; ++lane) {
+                auto y = b0 * x[lane] + s1[s][lane];
+                s1[s][lane] = b1 * x[lane] - a1 * y + s2[s][lane];
+                s2[s][lane] = b2 * x[lane] - a2 * y;
+                x[lane] = y;
+            }
+        }
+
+        for (int lane = 0; lane < NumLanes; ++lane)
+            lanes[lane][i] = x[lane];
+    }
+
+    for (int s = 0; s < numSections; ++s) {
+        std::copy(s1[s], s1[s] + NumLanes, state + (s * 2) * NumLanes);
+        std::copy(s2[s], s2[s] + NumLanes, state + (s * 2 + 1) * NumLanes);
+    }
+}
+
+void processScalar(const SectionCoefficients* sections, int numSections, float* state, float* const* lanes, int numSamples) {
+    processLanes<1>(sections, numSections, state, lanes, numSamples);
+}
+
+void processVector128(const SectionCoefficients* sections, int numSections, float* state, float* const* lanes, int numSamples) {
+    processLanes<4>(sections, numSections, state, lanes, numSamples);
+}
+
+EQ_LANE_BATCH_TARGET("avx2")
+void processAVX2(const SectionCoefficients* sections, int numSections, float* state, float* const* lanes, int numSamples) {
+    processLanes<8>(sections, numSections, state, lanes, numSamples);
+}
+
+EQ_LANE_BATCH_TARGET("avx512f")
+void processAVX512(const SectionCoefficients* sections, int numSections, float* state, float* const* lanes, int numSamples) {
+    processLanes<16>(sections, numSections, state, lanes, numSamples);
+}
+
+LaneBatchEngine::GroupFunction getGroupFunction(LaneBatchEngine::InstructionSet instructionSet) {
+    switch (instructionSet) {
+    case LaneBatchEngine::InstructionSet::AVX512: return processAVX512;
+    case LaneBatchEngine::InstructionSet::AVX2: return processAVX2;
+    case LaneBatchEngine::InstructionSet::Vector128: return processVector128;
+    default: return processScalar;
+    }
+}
+
+}
+
+LaneBatchEngine::InstructionSet LaneBatchEngine::detectInstructionSet() {
+   #if EQ_LANE_BATCH_TARGETS
+    if (juce::SystemStats::hasAVX512F())
+        return InstructionSet::AVX512;
+    if (juce::SystemStats::hasAVX2())
+        return InstructionSet::AVX2;
+   #endif
+
+   #if JUCE_USE_SIMD
+    return InstructionSet::Vector128;
+   #else
+    return InstructionSet::Scalar;
+   #endif
+}
+
+int LaneBatchEngine::getNumLanes(InstructionSet instructionSet) {
+    switch (instructionSet) {
+    case InstructionSet::AVX512: return 16;
+    case InstructionSet::AVX2: return 8;
+    case InstructionSet::Vector128: return 4;
+    default: return 1;
+    }
+}
+
+const char* LaneBatchEngine::getName(InstructionSet instructionSet) {
+    switch (instructionSet) {
+    case InstructionSet::AVX512: return "AVX-512";
+    case InstructionSet::AVX2: return "AVX2";
+    case InstructionSet::Vector128: return "128-bit";
+    default: return "Scalar";
+    }
+}
+
+LaneBatchEngine::LaneBatchEngine(InstructionSet newInstructionSet) :
+    instructionSet(newInstructionSet),
+    numLanes(getNumLanes(newInstructionSet)),
+    processGroup(getGroupFunction(newInstructionSet))
+{
+}
+
+void LaneBatchEngine::prepare(const ChainSettings& chainSettings, double sampleRate, int newNumSignals) {
+    //the MonoChain's order: low cut, peak, high cut
+    numSections = 0;
+    CutCoefficients cut;
+
+    if (!chainSettings.lowCutBypassed) {
+        designLowCutFilter(chainSettings, sampleRate, cut);
+        for (int i = 0; i <= chainSettings.lowCutSlope; ++i)
+            sections[(size_t)numSections++] = cut[(size_t)i];
+    }
+
+    if (!chainSettings.peakBypassed) {
+        auto peak = makePeakFilter(chainSettings, sampleRate);
+        auto* c = peak->getRawCoefficients();
+        sections[(size_t)numSections++] = { c[0], c[1], c[2], c[3], c[4] };
+    }
+
+    if (!chainSettings.highCutBypassed) {
+        designHighCutFilter(chainSettings, sampleRate, cut);
+        for (int i = 0; i <= chainSettings.highCutSlope; ++i)
+            sections[(size_t)numSections++] = cut[(size_t)i];
+    }
+
+    numSignals = juce::jmax(0, newNumSignals);
+    auto numGroups = (numSignals + numLanes - 1) / numLanes;
+    state.assign((size_t)(numGroups * maxSections * 2 * numLanes), 0.f);
+    padding.assign(chunkSize, 0.f);
+}
+
+void LaneBatchEngine::reset() {
+    std::fill(state.begin(), state.end(), 0.f);
+    std::fill(padding.begin(), padding.end(), 0.f);
+}
+
+void LaneBatchEngine::process(float* const* signals, int numSamples) {
+    if (numSections == 0)
+        return;
+
+    EQ_TRACE_SCOPE("LaneBatchEngine::process");
+    juce::ScopedNoDenormals noDenormals;
+
+    std::array<float*, 16> lanes;
+    auto groupStateSize = maxSections * 2 * numLanes;
+
+    for (int first = 0; first < numSignals; first += numLanes) {
+        auto* groupState = state.data() + (first / numLanes) * groupStateSize;
+
+        for (int start = 0; start < numSamples; start += chunkSize) {
+            auto length = juce::jmin(chunkSize, numSamples - start);
+
+            //lanes past the last signal filter silence into the shared padding, which stays silent
+            for (int lane = 0; lane < numLanes; ++lane)
+                lanes[(size_t)lane] = first + lane < numSignals ? signals[first + lane] + start : padding.data();
+
+            processGroup(sections.data(), numSections, groupState, lanes.data(), length);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    LaneBatchEngine.h
+    Offline engine running one set of EQ settings over many mono signals at
+    once, one signal per SIMD lane.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <vector>
+#include "EQCore.h"
+#include "Trace.h"
+
+/*  The MonoChain's sections (the cuts' Butterworth biquads and the peak,
+    leaving out bypassed stages) applied to numSignals independent mono
+    signals in lockstep. Signals are grouped numLanes at a time and each
+    group runs through a lane-innermost kernel like the crossover's
+    BandKernel, so one pass over the sections filters a whole group: 16
+    lanes with AVX-512, 8 with AVX2, 4 with SSE2 or NEON, 1 on the scalar
+    fallback. The instruction set is picked at runtime from the CPU.
+
+    The kernel is transposed direct form II, as juce::dsp::IIR::Filter, so
+    the output matches the MonoChain's to rounding (the AVX-512 path may fuse
+    multiply-adds). State is kept per signal, so long signals can be fed in
+    consecutive chunks. Offline use: prepare() allocates. */
+struct LaneBatchEngine {
+    enum class InstructionSet {
+        Scalar,
+        Vector128,
+        AVX2,
+        AVX512
+    };
+
+    //the widest set this CPU and build support
+    static InstructionSet detectInstructionSet();
+    static int getNumLanes(InstructionSet instructionSet);
+    static const char* getName(InstructionSet instructionSet);
+
+    explicit LaneBatchEngine(InstructionSet instructionSet = detectInstructionSet());
+
+    //designs the sections for 'sampleRate' and clears every signal's state
+    void prepare(const ChainSettings& chainSettings, double sampleRate, int numSignals);
+    void reset();
+
+    //filters numSamples of every signal in place; signals[i] continues where
+    //the previous call left signal i
+    void process(float* const* signals, int numSamples);
+
+    InstructionSet getInstructionSet() const { return instructionSet; }
+    int getNumLanes() const { return numLanes; }
+    int getNumSignals() const { return numSignals; }
+    int getNumSections() const { return numSections; }
+
+    //the longest a stage can be: 4 sections per cut and the peak
+    static constexpr int maxSections = 9;
+    //samples per kernel call, which bounds the scratch the padding lanes use
+    static constexpr int chunkSize = 1024;
+
+    using GroupFunction = void (*)(const SectionCoefficients* sections, int numSections, float* state,
+        float* const* lanes, int numSamples);
+private:
+    InstructionSet instructionSet;
+    int numLanes;
+    GroupFunction processGroup;
+
+    std::array<SectionCoefficients, maxSections> sections {};
+    int numSections = 0, numSignals = 0;
+
+    //per group: s1 then s2 of each section, lane-innermost
+    std::vector<float> state;
+    //read and written by the lanes of the last group that have no signal
+    std::vector<float> padding;
+};
@@ -0,0 +1,290 @@
+/*
+  ==============================================================================
+
+    LoudnessMeter.cpp
+    BS.1770 loudness (momentary / short-term / integrated) and 4x oversampled
+    true-peak metering of the processor output.
+
+  ==============================================================================
+*/
+
+#include "LoudnessMeter.h"
+#include <numeric>
+
+//re-derived for each sample rate from the analog prototypes' parameters
+std::array<juce::dsp::IIR::Coefficients<float>::Ptr, 2> LoudnessMeter::makeKWeighting(double sampleRate) {
+    using namespace juce;
+
+    std::array<dsp::IIR::Coefficients<float>::Ptr, 2> kWeighting;
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        auto k = std::tan(MathConstants<double>::pi * f0 / sampleRate);
+        auto vh = std::pow(10.0, gainDb / 20.0);
+        auto vb = std::pow(vh, 0.4996667741545416);
+        auto a0 = 1.0 + k / q + k * k;
+
+        kWeighting[0] = new dsp::IIR::Coefficients<float>(
+            float((vh + vb * k / q + k * k) / a0),
+            float(2.0 * (k * k - vh) / a0),
+            float((vh - vb * k / q + k * k) / a0),
+            1.f,
+            float(2.0 * (k * k - 1.0) / a0),
+            float((1.0 - k / q + k * k) / a0));
+    }
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        auto k = std::tan(MathConstants<double>::pi * f0 / sampleRate);
+        auto a0 = 1.0 + k / q + k * k;
+
+        kWeighting[1] = new dsp::IIR::Coefficients<float>(
+            1.f, -2.f, 1.f,
+            1.f,
+            float(2.0 * (k * k - 1.0) / a0),
+            float((1.0 - k / q + k * k) / a0));
+    }
+
+    return kWeighting;
+}
+
+void LoudnessMeter::prepare(double sampleRate, int maximumBlockSize) {
+    using namespace juce;
+
+    maxBlockSize = jmax(1, maximumBlockSize);
+    subBlockLength = jmax(1, roundToInt(sampleRate * 0.1));
+
+    auto kWeighting = makeKWeighting(sampleRate);
+    for (auto& filter : shelfFilters)
+        filter.coefficients = kWeighting[0];
+    for (auto& filter : highpassFilters)
+        filter.coefficients = kWeighting[1];
+
+    dsp::ProcessSpec spec;
+    spec.maximumBlockSize = (uint32)maxBlockSize;
+    spec.numChannels = 1;
+    spec.sampleRate = sampleRate;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        shelfFilters[channel].prepare(spec);
+        highpassFilters[channel].prepare(spec);
+    }
+
+    //interpolator phases, each normalised to unity gain at DC
+    {
+        constexpr int numTaps = oversampling * tapsPerPhase;
+        std::array<float, numTaps> window;
+        dsp::WindowingFunction<float>::fillWindowingTables(window.data(), numTaps,
+            dsp::WindowingFunction<float>::kaiser, false, 5.f);
+
+        for (int n = 0; n < numTaps; ++n) {
+            auto t = (n - (numTaps - 1) * 0.5f) / float(oversampling);
+            auto sinc = t == 0.f ? 1.f : std::sin(MathConstants<float>::pi * t) / (MathConstants<float>::pi * t);
+            phases[n % oversampling][n / oversampling] = sinc * window[n];
+        }
+
+        for (auto& phase : phases) {
+            auto sum = std::accumulate(phase.begin(), phase.end(), 0.f);
+            for (auto& tap : phase)
+                tap /= sum;
+        }
+    }
+
+    weighted.setSize(numChannels, maxBlockSize);
+    history.setSize(numChannels, tapsPerPhase - 1 + maxBlockSize);
+    interpolated.allocate((size_t)maxBlockSize, true);
+
+    reset();
+}
+
+void LoudnessMeter::reset() {
+    for (int channel = 0; channel < numChannels; ++channel) {
+        shelfFilters[channel].reset();
+        highpassFilters[channel].reset();
+    }
+
+    history.clear();
+
+    subBlockPosition = 0;
+    subBlockEnergy = 0.0;
+    subBlockPowers.fill(0.0);
+    subBlockIndex = 0;
+    numSubBlocks = 0;
+
+    histogramPower.fill(0.0);
+    histogramCount.fill(0);
+
+    truePeak = 0.f;
+    maxTruePeak = 0.f;
+
+    latestMomentary.store(silenceLufs);
+    latestShortTerm.store(silenceLufs);
+    latestIntegrated.store(silenceLufs);
+    latestTruePeak.store(silenceLufs);
+    latestMaxTruePeak.store(silenceLufs);
+}
+
+void LoudnessMeter::process(const juce::AudioBuffer<float>& buffer) {
+    jassert(buffer.getNumChannels() >= numChannels);
+
+    //anything larger than the prepared block size is metered in pieces, so nothing allocates
+    auto numSamples = buffer.getNumSamples();
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+        processChunk(buffer, start, juce::jmin(maxBlockSize, numSamples - start));
+}
+
+void LoudnessMeter::processSilence(int numSamples) {
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::clear(history.getWritePointer(channel), tapsPerPhase - 1);
+
+    addSubBlockSamples(nullptr, numSamples);
+}
+
+void LoudnessMeter::processChunk(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    using namespace juce;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        auto* input = buffer.getReadPointer(channel, startSample);
+
+        //true peak: each phase is a 12 tap FIR run across the whole chunk, one
+        //vectorised multiply-add per tap
+        auto* hist = history.getWritePointer(channel);
+        FloatVectorOperations::copy(hist + tapsPerPhase - 1, input, numSamples);
+
+        auto range = FloatVectorOperations::findMinAndMax(input, numSamples);
+        auto peak = jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
+
+        for (auto& phase : phases) {
+            FloatVectorOperations::clear(interpolated.get(), numSamples);
+
+            for (int tap = 0; tap < tapsPerPhase; ++tap)
+                FloatVectorOperations::addWithMultiply(interpolated.get(), hist + tapsPerPhase - 1 - tap, phase[tap], numSamples);
+
+            range = FloatVectorOperations::findMinAndMax(interpolated.get(), numSamples);
+            peak = jmax(peak, std::abs(range.getStart()), std::abs(range.getEnd()));
+        }
+
+        truePeak = jmax(truePeak, peak);
+        maxTruePeak = jmax(maxTruePeak, peak);
+
+        std::copy(hist + numSamples, hist + numSamples + tapsPerPhase - 1, hist);
+
+        //loudness
+        FloatVectorOperations::copy(weighted.getWritePointer(channel), input, numSamples);
+
+        auto block = dsp::AudioBlock<float>(weighted).getSingleChannelBlock((size_t)channel).getSubBlock(0, (size_t)numSamples);
+        dsp::ProcessContextReplacing<float> context(block);
+        shelfFilters[channel].process(context);
+        highpassFilters[channel].process(context);
+    }
+
+    addSubBlockSamples(weighted.getArrayOfReadPointers(), numSamples);
+}
+
+void LoudnessMeter::addSubBlockSamples(const float* const* weightedChannels, int numSamples) {
+    int position = 0;
+
+    while (position < numSamples) {
+        auto num = juce::jmin(numSamples - position, subBlockLength - subBlockPosition);
+
+        if (weightedChannels != nullptr) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                auto* samples = weightedChannels[channel] + position;
+
+                float energy = 0.f;
+                for (int i = 0; i < num; ++i)
+                    energy += samples[i] * samples[i];
+
+                subBlockEnergy += energy;
+            }
+        }
+
+        position += num;
+        subBlockPosition += num;
+
+        if (subBlockPosition == subBlockLength)
+            finishSubBlock();
+    }
+}
+
+void LoudnessMeter::finishSubBlock() {
+    subBlockPowers[subBlockIndex] = subBlockEnergy / subBlockLength;
+    subBlockIndex = (subBlockIndex + 1) % subBlocksPerShortTerm;
+    numSubBlocks = juce::jmin(numSubBlocks + 1, subBlocksPerShortTerm);
+
+    subBlockEnergy = 0.0;
+    subBlockPosition = 0;
+
+    auto averageOfLast = [this](int count) {
+        double sum = 0.0;
+        for (int i = 1; i <= count; ++i)
+            sum += subBlockPowers[(subBlockIndex - i + subBlocksPerShortTerm) % subBlocksPerShortTerm];
+        return sum / count;
+    };
+
+    LoudnessReading reading;
+
+    if (numSubBlocks >= subBlocksPerMomentary) {
+        auto momentaryPower = averageOfLast(subBlocksPerMomentary);
+        reading.momentaryLufs = powerToLufs(momentaryPower);
+
+        //every momentary block is also a gating block for the integrated loudness
+        if (reading.momentaryLufs > absoluteGateLufs) {
+            auto bin = juce::jlimit(0, numHistogramBins - 1,
+                int((reading.momentaryLufs - absoluteGateLufs) / histogramStepLu));
+            histogramPower[bin] += momentaryPower;
+            ++histogramCount[bin];
+        }
+    }
+
+    reading.shortTermLufs = powerToLufs(averageOfLast(numSubBlocks));
+    reading.integratedLufs = computeIntegratedLufs();
+    reading.truePeakDb = juce::Decibels::gainToDecibels(truePeak, silenceLufs);
+    reading.maxTruePeakDb = juce::Decibels::gainToDecibels(maxTruePeak, silenceLufs);
+
+    truePeak = 0.f;
+
+    latestMomentary.store(reading.momentaryLufs);
+    latestShortTerm.store(reading.shortTermLufs);
+    latestIntegrated.store(reading.integratedLufs);
+    latestTruePeak.store(reading.truePeakDb);
+    latestMaxTruePeak.store(reading.maxTruePeakDb);
+
+    //the atomics above always hold the latest values; a full fifo only drops history
+    readings.push(reading);
+}
+
+float LoudnessMeter::computeIntegratedLufs() const {
+    double power = 0.0;
+    int count = 0;
+
+    for (int bin = 0; bin < numHistogramBins; ++bin) {
+        power += histogramPower[bin];
+        count += histogramCount[bin];
+    }
+
+    if (count == 0)
+        return silenceLufs;
+
+    auto relativeGate = powerToLufs(power / count) + relativeGateLu;
+    auto firstBin = juce::jlimit(0, numHistogramBins,
+        (int)std::ceil((relativeGate - absoluteGateLufs) / histogramStepLu));
+
+    power = 0.0;
+    count = 0;
+
+    for (int bin = firstBin; bin < numHistogramBins; ++bin) {
+        power += histogramPower[bin];
+        count += histogramCount[bin];
+    }
+
+    return count > 0 ? powerToLufs(power / count) : silenceLufs;
+}
+
+LoudnessReading LoudnessMeter::getLatestReading() const {
+    LoudnessReading reading;
+    reading.momentaryLufs = latestMomentary.load();
+    reading.shortTermLufs = latestShortTerm.load();
+    reading.integratedLufs = latestIntegrated.load();
+    reading.truePeakDb = latestTruePeak.load();
+    reading.maxTruePeakDb = latestMaxTruePeak.load();
+    return reading;
+}
@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    LoudnessMeter.h
+    BS.1770 loudness (momentary / short-term / integrated) and 4x oversampled
+    true-peak metering of the processor output.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "Fifo.h"
+
+struct LoudnessReading {
+    float momentaryLufs { -100.f }, shortTermLufs { -100.f }, integratedLufs { -100.f };
+    //true peak since the previous reading, and since the last reset
+    float truePeakDb { -100.f }, maxTruePeakDb { -100.f };
+};
+
+struct LoudnessMeter {
+    void prepare(double sampleRate, int maximumBlockSize);
+    void reset();
+
+    //audio thread, with the post-EQ stereo output
+    void process(const juce::AudioBuffer<float>& buffer);
+    //audio thread, advances the meter over digital silence without touching samples
+    void processSilence(int numSamples);
+
+    //one reading per 100 ms, through the same kind of fifo the analyzer uses
+    int getNumReadingsAvailable() const { return readings.getNumAvailableForReading(); }
+    bool pullReading(LoudnessReading& reading) { return readings.pull(reading); }
+    int getNumDroppedReadings() const { return readings.getNumDroppedPushes(); }
+
+    //most recent values, safe from any thread (e.g. after an offline render)
+    LoudnessReading getLatestReading() const;
+
+    size_t getAllocatedBytes() const {
+        return getHeapBytes(weighted) + getHeapBytes(history) + (size_t)maxBlockSize * sizeof(float);
+    }
+
+    static constexpr float silenceLufs = -100.f;
+
+    //the BS.1770 K-weighting, pre-filter shelf then RLB highpass, for 'sampleRate'
+    static std::array<juce::dsp::IIR::Coefficients<float>::Ptr, 2> makeKWeighting(double sampleRate);
+private:
+    static constexpr int numChannels = 2;
+
+    //true peak: 48 tap windowed-sinc interpolator split into 4 phases of 12 taps
+    static constexpr int oversampling = 4;
+    static constexpr int tapsPerPhase = 12;
+
+    //gating blocks are 400 ms with 75% overlap, so everything is built from 100 ms sub-blocks
+    static constexpr int subBlocksPerMomentary = 4;
+    static constexpr int subBlocksPerShortTerm = 30;
+
+    //integrated loudness keeps a histogram of block powers instead of every block
+    static constexpr float absoluteGateLufs = -70.f;
+    static constexpr float relativeGateLu = -10.f;
+    static constexpr float histogramStepLu = 0.1f;
+    static constexpr int numHistogramBins = 800;
+
+    void processChunk(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void addSubBlockSamples(const float* const* weightedChannels, int numSamples);
+    void finishSubBlock();
+    float computeIntegratedLufs() const;
+
+    static float powerToLufs(double power) {
+        return power > 0.0 ? juce::jmax(silenceLufs, float(-0.691 + 10.0 * std::log10(power))) : silenceLufs;
+    }
+
+    using Filter = juce::dsp::IIR::Filter<float>;
+    std::array<Filter, numChannels> shelfFilters, highpassFilters;
+
+    std::array<std::array<float, tapsPerPhase>, oversampling> phases;
+
+    int maxBlockSize = 0;
+    juce::AudioBuffer<float> weighted, history;
+    juce::HeapBlock<float> interpolated;
+
+    int subBlockLength = 4800, subBlockPosition = 0;
+    double subBlockEnergy = 0.0;
+
+    std::array<double, subBlocksPerShortTerm> subBlockPowers {};
+    int subBlockIndex = 0, numSubBlocks = 0;
+
+    std::array<double, numHistogramBins> histogramPower {};
+    std::array<int, numHistogramBins> histogramCount {};
+
+    float truePeak = 0.f, maxTruePeak = 0.f;
+
+    std::atomic<float> latestMomentary { silenceLufs }, latestShortTerm { silenceLufs },
+        latestIntegrated { silenceLufs }, latestTruePeak { silenceLufs }, latestMaxTruePeak { silenceLufs };
+
+    Fifo<LoudnessReading> readings;
+};
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    MultiResolutionAnalyzer.cpp
+    Octave-decimated analyzer: the same 2048-point FFT run at 1x, 1/2x, 1/4x and
+    1/8x the sample rate, stitched into one log-frequency spectrum.
+
+  ==============================================================================
+*/
+
+#include "MultiResolutionAnalyzer.h"
+#include "Trace.h"
+
+void MultiResolutionAnalyzer::prepare(double newSampleRate, float newNegativeInfinity) {
+    sampleRate = newSampleRate;
+    negativeInfinity = newNegativeInfinity;
+
+    forwardFFT = &analysisService->getFFT(fftOrder);
+    window = &analysisService->getWindow(fftSize);
+
+    fftData.assign(fftSize * 2, 0.f);
+    spectrum.assign(numLogPoints, negativeInfinity);
+    spectrumFifo.prepare(spectrum.size());
+
+    for (int b = 0; b < numBands; ++b) {
+        auto& band = bands[b];
+        auto bandRate = sampleRate / double(1 << b);
+
+        band.history.assign(fftSize, 0.f);
+        band.writeIndex = 0;
+        band.samplesSinceAnalysis = 0;
+        band.keepNextSample = true;
+
+        band.magnitudesDb.assign(fftSize / 2, negativeInfinity);
+        band.binWidth = bandRate / fftSize;
+        band.hopSeconds = hopSize / bandRate;
+        band.smoother.prepare(fftSize / 2);
+        band.lowerEdge = b + 1 < numBands ? sampleRate / double(1 << (b + 3)) : 0.0;
+
+        if (b > 0) {
+            //cutoff at 0.3x the decimated rate: flat to the band's upper edge at
+            //0.25x, and more than 60 dB down where aliases would fold onto it
+            auto inputRate = bandRate * 2.0;
+            auto coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(
+                float(bandRate * 0.3), inputRate, 8);
+
+            juce::dsp::ProcessSpec spec;
+            spec.maximumBlockSize = 1;
+            spec.numChannels = 1;
+            spec.sampleRate = inputRate;
+
+            for (int i = 0; i < (int)band.decimationFilters.size(); ++i) {
+                band.decimationFilters[i].coefficients = coefficients[i];
+                band.decimationFilters[i].prepare(spec);
+            }
+        }
+    }
+}
+
+void MultiResolutionAnalyzer::release() {
+    for (auto& band : bands) {
+        band.history = {};
+        band.magnitudesDb = {};
+        band.smoother.release();
+    }
+
+    fftData = {};
+    spectrum = {};
+    spectrumFifo.release();
+
+    sampleRate = 0.0;
+}
+
+size_t MultiResolutionAnalyzer::getAllocatedBytes() const {
+    size_t bytes = getHeapBytes(fftData) + getHeapBytes(spectrum) + spectrumFifo.getAllocatedBytes();
+
+    for (auto& band : bands)
+        bytes += getHeapBytes(band.history) + getHeapBytes(band.magnitudesDb) + band.smoother.getAllocatedBytes();
+
+    return bytes;
+}
+
+void MultiResolutionAnalyzer::push(const float* samples, int numSamples) {
+    jassert(sampleRate > 0.0);
+
+    for (int i = 0; i < numSamples; ++i)
+        pushIntoBand(0, samples[i]);
+
+    auto changed = false;
+    for (auto& band : bands) {
+        if (band.samplesSinceAnalysis >= hopSize) {
+            analyzeBand(band);
+            band.samplesSinceAnalysis = 0;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        stitch();
+}
+
+void MultiResolutionAnalyzer::pushIntoBand(int bandIndex, float sample) {
+    auto& band = bands[bandIndex];
+
+    band.history[band.writeIndex] = sample;
+    band.writeIndex = (band.writeIndex + 1) % fftSize;
+    ++band.samplesSinceAnalysis;
+
+    if (bandIndex + 1 < numBands) {
+        auto& next = bands[bandIndex + 1];
+
+        for (auto& filter : next.decimationFilters)
+            sample = filter.processSample(sample);
+
+        if (next.keepNextSample)
+            pushIntoBand(bandIndex + 1, sample);
+
+        next.keepNextSample = !next.keepNextSample;
+    }
+}
+
+void MultiResolutionAnalyzer::analyzeBand(Band& band) {
+    //unroll the ring so the oldest sample comes first
+    auto tail = fftSize - band.writeIndex;
+    std::copy(band.history.begin() + band.writeIndex, band.history.end(), fftData.begin());
+    std::copy(band.history.begin(), band.history.begin() + band.writeIndex, fftData.begin() + tail);
+    std::fill(fftData.begin() + fftSize, fftData.end(), 0.f);
+
+    window->multiplyWithWindowingTable(fftData.data(), fftSize);
+    {
+        EQ_TRACE_SCOPE("FFT (multi-resolution)");
+        forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());
+    }
+
+    //same normalisation as FFTDataGenerator
+    int numBins = fftSize / 2;
+    for (int i = 0; i < numBins; ++i) {
+        auto nv = fftData[i];
+        if (!std::isinf(nv) && !std::isnan(nv))
+            nv /= float(numBins);
+        else
+            nv = 0.f;
+        fftData[i] = nv;
+    }
+
+    band.smoother.process(fftData.data(), numBins, float(band.hopSeconds));
+
+    for (int i = 0; i < numBins; ++i)
+        band.magnitudesDb[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+}
+
+void MultiResolutionAnalyzer::stitch() {
+    const int numBins = fftSize / 2;
+
+    for (int i = 0; i < numLogPoints; ++i) {
+        auto freq = getLogPointFrequency(i);
+
+        //the finest band whose range still reaches this frequency
+        int b = 0;
+        while (b + 1 < numBands && freq < bands[b].lowerEdge)
+            ++b;
+
+        auto& band = bands[b];
+        auto binPosition = freq / band.binWidth;
+        auto bin = juce::jlimit(0, numBins - 2, (int)binPosition);
+        auto frac = juce::jlimit(0.f, 1.f, float(binPosition - bin));
+
+        spectrum[i] = band.magnitudesDb[bin] + frac * (band.magnitudesDb[bin + 1] - band.magnitudesDb[bin]);
+    }
+
+    //the bands' magnitudes hold all state, so a recycled vector is fine to refill
+    spectrumFifo.pushSwap(spectrum);
+}
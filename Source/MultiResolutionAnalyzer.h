@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    MultiResolutionAnalyzer.h
+    Octave-decimated analyzer: the same 2048-point FFT run at 1x, 1/2x, 1/4x and
+    1/8x the sample rate, stitched into one log-frequency spectrum.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisService.h"
+#include "Fifo.h"
+#include "SpectrumSmoother.h"
+
+/*  At 48 kHz the bands resolve 23, 11.7, 5.9 and 2.9 Hz. Each band covers the
+    octave below the one above it (band 0 from fs/8 up, band 1 from fs/16 to
+    fs/8 and so on), staying well inside its decimation filter's passband.
+    Decimated bands hop in their own, slower time base, so a full update costs
+    1 + 1/2 + 1/4 + 1/8 small FFTs rather than one 8192-point FFT per hop. */
+struct MultiResolutionAnalyzer {
+    static constexpr int numBands = 4;
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 4;
+    static constexpr int numLogPoints = 512;
+
+    void prepare(double newSampleRate, float newNegativeInfinity);
+    //frees all storage, prepare() has to run again before the next push()
+    void release();
+    size_t getAllocatedBytes() const;
+    double getSampleRate() const { return sampleRate; }
+
+    //feeds new full-rate samples; spectra appear in the fifo as bands update
+    void push(const float* samples, int numSamples);
+
+    //forwarded to every band, each averages in its own time base
+    void setSmoothing(SpectrumSmoother::Smoothing smoothing, SpectrumSmoother::Averaging averaging, float decaySeconds) {
+        for (auto& band : bands) {
+            band.smoother.setSmoothing(smoothing);
+            band.smoother.setAveraging(averaging, decaySeconds);
+        }
+    }
+
+    int getNumSpectraAvailable() const { return spectrumFifo.getNumAvailableForReading(); }
+    //a correctly sized 'destination' is swapped in rather than copied
+    bool getSpectrum(std::vector<float>& destination) {
+        if (destination.size() == spectrum.size())
+            return spectrumFifo.pullSwap(destination);
+
+        return spectrumFifo.pull(destination);
+    }
+
+    int getNumDroppedSpectra() const { return spectrumFifo.getNumDroppedPushes(); }
+
+    //the spectrum's points are spaced evenly in log frequency from 20 Hz to 20 kHz
+    static float getLogPointFrequency(int index) {
+        return juce::mapToLog10(float(index) / float(numLogPoints - 1), 20.f, 20000.f);
+    }
+private:
+    using Filter = juce::dsp::IIR::Filter<float>;
+
+    struct Band {
+        std::vector<float> history;
+        int writeIndex = 0, samplesSinceAnalysis = 0;
+
+        //lowpass ahead of this band's 2:1 decimation (unused for band 0)
+        std::array<Filter, 4> decimationFilters;
+        bool keepNextSample = true;
+
+        SpectrumSmoother smoother;
+        std::vector<float> magnitudesDb;
+        double binWidth = 1.0, lowerEdge = 0.0, hopSeconds = 0.01;
+    };
+
+    void pushIntoBand(int bandIndex, float sample);
+    void analyzeBand(Band& band);
+    void stitch();
+
+    std::array<Band, numBands> bands;
+    std::vector<float> fftData, spectrum;
+
+    juce::SharedResourcePointer<AnalysisService> analysisService;
+    juce::dsp::FFT* forwardFFT = nullptr;
+    juce::dsp::WindowingFunction<float>* window = nullptr;
+
+    Fifo<std::vector<float>> spectrumFifo;
+
+    double sampleRate = 0.0;
+    float negativeInfinity = -48.f;
+};
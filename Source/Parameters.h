@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    Parameters.h
+    Compile-time registry of every plugin parameter: IDs, ranges and defaults.
+    The layout, the audio thread and the editor all go through it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+//the order is the host-visible parameter order, don't reorder existing entries
+enum class ParameterId {
+    LowCutFreq,
+    HighCutFreq,
+    PeakFreq,
+    PeakGain,
+    PeakQuality,
+    LowCutSlope,
+    HighCutSlope,
+    LowCutBypassed,
+    PeakBypassed,
+    HighCutBypassed,
+    AnalyzerEnabled,
+    CrossoverEnabled,
+    CrossoverBands,
+    CrossoverLowFreq,
+    CrossoverMidFreq,
+    CrossoverHighFreq,
+    CrossoverSlope,
+    AutoGain,
+    FilterBackend,
+
+    NumParameters
+};
+
+constexpr int numParameters = (int)ParameterId::NumParameters;
+
+enum class ParameterKind {
+    Float,
+    Choice,
+    Bool
+};
+
+struct ParameterSpec {
+    ParameterId index;
+    const char* id;
+    ParameterKind kind;
+    float minimum, maximum, interval, skew;
+    float defaultValue;
+    const char* const* choices;
+    int numChoices;
+};
+
+inline constexpr const char* slopeChoices[] = { "12 db/Oct", "24 db/Oct", "36 db/Oct", "48 db/Oct" };
+inline constexpr const char* crossoverBandChoices[] = { "2 Bands", "3 Bands", "4 Bands" };
+inline constexpr const char* filterBackendChoices[] = { "Biquad", "State Variable" };
+inline constexpr const char* crossoverSlopeChoices[] = { "12 db/Oct (LR2)", "24 db/Oct (LR4)", "36 db/Oct (LR6)", "48 db/Oct (LR8)" };
+
+inline constexpr std::array<ParameterSpec, numParameters> parameterSpecs { {
+    { ParameterId::LowCutFreq,      "LowCut Freq",      ParameterKind::Float,  20.f,  20000.f, 1.f,   0.25f, 20.f,    nullptr, 0 },
+    { ParameterId::HighCutFreq,     "HighCut Freq",     ParameterKind::Float,  20.f,  20000.f, 1.f,   0.25f, 20000.f, nullptr, 0 },
+    { ParameterId::PeakFreq,        "Peak Freq",        ParameterKind::Float,  20.f,  20000.f, 1.f,   0.25f, 750.f,   nullptr, 0 },
+    { ParameterId::PeakGain,        "Peak Gain",        ParameterKind::Float,  -24.f, 24.f,    0.5f,  1.f,   0.f,     nullptr, 0 },
+    { ParameterId::PeakQuality,     "Peak Quality",     ParameterKind::Float,  0.1f,  10.f,    0.05f, 1.f,   1.f,     nullptr, 0 },
+    { ParameterId::LowCutSlope,     "LowCut Slope",     ParameterKind::Choice, 0.f,   3.f,     1.f,   1.f,   0.f,     slopeChoices, 4 },
+    { ParameterId::HighCutSlope,    "HighCut Slope",    ParameterKind::Choice, 0.f,   3.f,     1.f,   1.f,   0.f,     slopeChoices, 4 },
+    { ParameterId::LowCutBypassed,  "LowCut Bypassed",  ParameterKind::Bool,   0.f,   1.f,     1.f,   1.f,   0.f,     nullptr, 0 },
+    { ParameterId::PeakBypassed,    "Peak Bypassed",    ParameterKind::Bool,   0.f,   1.f,     1.f,   1.f,   0.f,     nullptr, 0 },
+    { ParameterId::HighCutBypassed, "HighCut Bypassed", ParameterKind::Bool,   0.f,   1.f,     1.f,   1.f,   0.f,     nullptr, 0 },
+    { ParameterId::AnalyzerEnabled, "Analyzer Enabled", ParameterKind::Bool,   0.f,   1.f,     1.f,   1.f,   1.f,     nullptr, 0 },
+    { ParameterId::CrossoverEnabled,  "Crossover Enabled",   ParameterKind::Bool,   0.f,  1.f,     1.f, 1.f,   0.f,    nullptr, 0 },
+    { ParameterId::CrossoverBands,    "Crossover Bands",     ParameterKind::Choice, 0.f,  2.f,     1.f, 1.f,   0.f,    crossoverBandChoices, 3 },
+    { ParameterId::CrossoverLowFreq,  "Crossover Low Freq",  ParameterKind::Float,  20.f, 20000.f, 1.f, 0.25f, 200.f,  nullptr, 0 },
+    { ParameterId::CrossoverMidFreq,  "Crossover Mid Freq",  ParameterKind::Float,  20.f, 20000.f, 1.f, 0.25f, 1000.f, nullptr, 0 },
+    { ParameterId::CrossoverHighFreq, "Crossover High Freq", ParameterKind::Float,  20.f, 20000.f, 1.f, 0.25f, 5000.f, nullptr, 0 },
+    { ParameterId::CrossoverSlope,    "Crossover Slope",     ParameterKind::Choice, 0.f,  3.f,     1.f, 1.f,   1.f,    crossoverSlopeChoices, 4 },
+    { ParameterId::AutoGain,          "Auto Gain",           ParameterKind::Bool,   0.f,  1.f,     1.f, 1.f,   0.f,    nullptr, 0 },
+    { ParameterId::FilterBackend,     "Filter Backend",      ParameterKind::Choice, 0.f,  1.f,     1.f, 1.f,   0.f,    filterBackendChoices, 2 },
+} };
+
+constexpr bool isRegistryInOrder() {
+    for (int i = 0; i < numParameters; ++i) {
+        if ((int)parameterSpecs[i].index != i)
+            return false;
+    }
+    return true;
+}
+
+static_assert(isRegistryInOrder(), "parameterSpecs must be listed in ParameterId order");
+
+constexpr const ParameterSpec& getParameterSpec(ParameterId id) { return parameterSpecs[(size_t)id]; }
+
+inline juce::String getParameterID(ParameterId id) { return getParameterSpec(id).id; }
+
+//every parameter's value pointer, resolved once instead of by string on each read
+struct ParameterCache {
+    explicit ParameterCache(juce::AudioProcessorValueTreeState& apvts) {
+        for (int i = 0; i < numParameters; ++i) {
+            values[i] = apvts.getRawParameterValue(parameterSpecs[i].id);
+            jassert(values[i] != nullptr);
+        }
+    }
+
+    float get(ParameterId id) const { return values[(size_t)id]->load(); }
+private:
+    std::array<std::atomic<float>*, numParameters> values;
+};
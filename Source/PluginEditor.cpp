@@ -9,6 +9,60 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+const juce::Image& KnobFilmstrips::getFrame(const Key& key, float sliderPosProportional) {
+    if (strips.size() >= maxStrips && strips.find(key) == strips.end())
+        strips.clear();
+
+    auto& frames = strips[key];
+    if (frames.empty())
+        frames.resize(numFrames);
+
+    auto index = juce::jlimit(0, numFrames - 1, juce::roundToInt(sliderPosProportional * (numFrames - 1)));
+    auto& frame = frames[(size_t)index];
+
+    if (!frame.isValid()) {
+        auto size = float(key.diameter + 2 * margin);
+        auto pixels = juce::jmax(1, juce::roundToInt(size * key.scale));
+        frame = juce::Image(juce::Image::ARGB, pixels, pixels, true, juce::SoftwareImageType());
+
+        juce::Graphics g(frame);
+        g.addTransform(juce::AffineTransform::scale(pixels / size));
+
+        auto angle = juce::jmap(float(index) / float(numFrames - 1), key.startAngle, key.endAngle);
+        LookAndFeel::drawKnobBody(g, juce::Rectangle<float>((float)margin, (float)margin, (float)key.diameter, (float)key.diameter),
+            angle, key.enabled, key.pointerInset);
+    }
+
+    return frame;
+}
+
+//==============================================================================
+
+void LookAndFeel::drawKnobBody(juce::Graphics& g, juce::Rectangle<float> bounds,
+    float angle, bool enabled, float pointerInset) {
+    using namespace juce;
+
+    g.setColour(enabled ? Colour(97u, 18u, 167u) : Colours::darkgrey);
+    g.fillEllipse(bounds);
+
+    g.setColour(enabled ? Colour(255u, 176u, 0u) : Colours::grey);
+    g.drawEllipse(bounds, 1.f);
+
+    auto center = bounds.getCentre();
+
+    Path p;
+
+    Rectangle<float> r;
+    r.setLeft(center.getX() - 2);
+    r.setRight(center.getX() + 2);
+    r.setTop(bounds.getY());
+    r.setBottom(center.getY() - pointerInset);
+
+    p.addRoundedRectangle(r, 2.f);
+    p.applyTransform(AffineTransform().rotated(angle, center.getX(), center.getY()));
+    g.fillPath(p);
+}
+
 void LookAndFeel::drawRotarySlider(juce::Graphics& g,
     int x, int y, int width, int height,
     float sliderPosProportional,
@@ -21,34 +75,26 @@ void LookAndFeel::drawRotarySlider(juce::Graphics& g,
 
     auto enabled = slider.isEnabled();
 
-    g.setColour(enabled ? Colour(97u, 18u, 167u) : Colours::darkgrey);
-    g.fillEllipse(bounds);
-
-    g.setColour(enabled ? Colour(255u, 176u, 0u) : Colours::grey);
-    g.drawEllipse(bounds, 1.f);
-
     if (auto* rswl = dynamic_cast<RotarySliderWithLabels*>(&slider)) {
-        auto center = bounds.getCentre();
-
-        Path p;
-
-        Rectangle<float> r;
-        r.setLeft(center.getX() - 2);
-        r.setRight(center.getX() + 2);
-        r.setTop(bounds.getY());
-        r.setBottom(center.getY() - rswl->getTextHeight() * 1.5);
+        jassert(rotaryStartAngle < rotaryEndAngle);
+        auto pointerInset = rswl->getTextHeight() * 1.5f;
 
-        p.addRoundedRectangle(r, 2.f);
+        if (useKnobFilmstrips && width == height) {
+            KnobFilmstrips::Key key { width, g.getInternalContext().getPhysicalPixelScaleFactor(),
+                enabled, pointerInset, rotaryStartAngle, rotaryEndAngle };
 
-        jassert(rotaryStartAngle < rotaryEndAngle);
-        auto sliderAngleRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
-        p.applyTransform(AffineTransform().rotated(sliderAngleRad, center.getX(), center.getY()));
-        g.fillPath(p);
+            g.drawImage(knobFilmstrips.getFrame(key, sliderPosProportional), bounds.expanded((float)KnobFilmstrips::margin));
+        }
+        else {
+            auto sliderAngleRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
+            drawKnobBody(g, bounds, sliderAngleRad, enabled, pointerInset);
+        }
 
         g.setFont(rswl->getTextHeight());
         auto text = rswl->getDisplayString();
         auto strWidth = g.getCurrentFont().getStringWidth(text);
 
+        Rectangle<float> r;
         r.setSize(strWidth + 4, rswl->getTextHeight() + 2);
         r.setCentre(bounds.getCentre());
 
@@ -58,6 +104,13 @@ void LookAndFeel::drawRotarySlider(juce::Graphics& g,
         g.setColour(enabled ? Colours::white : Colours::lightgrey);
         g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
     }
+    else {
+        g.setColour(enabled ? Colour(97u, 18u, 167u) : Colours::darkgrey);
+        g.fillEllipse(bounds);
+
+        g.setColour(enabled ? Colour(255u, 176u, 0u) : Colours::grey);
+        g.drawEllipse(bounds, 1.f);
+    }
 }
 
 void LookAndFeel::drawToggleButton(juce::Graphics& g,
@@ -107,6 +160,17 @@ void LookAndFeel::drawToggleButton(juce::Graphics& g,
 
         g.strokePath(analyzerButton->randomPath, PathStrokeType(1.f));
     }
+    else if (dynamic_cast<SpectrogramButton*>(&toggleButton) != nullptr) {
+        auto color = ! toggleButton.getToggleState() ? Colours::dimgrey : Colour(0u, 172u, 1u);
+        g.setColour(color);
+
+        auto bounds = toggleButton.getLocalBounds();
+        g.drawRect(bounds);
+
+        auto insetRect = bounds.reduced(4);
+        for (auto y = insetRect.getY(); y < insetRect.getBottom(); y += 3)
+            g.drawHorizontalLine(y, (float)insetRect.getX(), (float)insetRect.getRight());
+    }
 }
 
 //==============================================================================
@@ -148,11 +212,11 @@ void RotarySliderWithLabels::paint(juce::Graphics& g) {
 
         auto str = labels[i].label;
         Rectangle<float> r;
-        r.setSize(g.getCurrentFont().getStringWidth(str), getTextHeight());
+        r.setSize(glyphCache->getWidth(str, (float)getTextHeight()), getTextHeight());
         r.setCentre(c);
         r.setY(r.getY() + getTextHeight());
 
-        g.drawFittedText(str, r.toNearestInt(), Justification::centred, 1);
+        glyphCache->draw(g, str, (float)getTextHeight(), r, Justification::centred);
     }
 }
 
@@ -198,27 +262,144 @@ juce::String RotarySliderWithLabels::getDisplayString() const {
 
 //==============================================================================
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate) {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+void PathProducer::setRenderParameters(juce::Rectangle<float> fftBounds, double sampleRate) {
+    const juce::SpinLock::ScopedLockType sl(renderParametersLock);
+    renderBounds = fftBounds;
+    renderSampleRate = sampleRate;
+}
+
+bool PathProducer::pullNextBuffer() {
+    if (!hasNextBuffer() || !channelFifo->getAudioBuffer(tempIncomingBuffer))
+        return false;
+
+    auto size = tempIncomingBuffer.getNumSamples();
+
+    //one spectrum is produced per incoming block
+    {
+        const juce::SpinLock::ScopedLockType sl(renderParametersLock);
+        channelFFTDataGenerator.setFramePeriod(float(size / renderSampleRate));
+    }
+
+    juce::FloatVectorOperations::copy(
+        monoBuffer.getWritePointer(0, 0),
+        monoBuffer.getReadPointer(0, size),
+        monoBuffer.getNumSamples() - size);
+
+    juce::FloatVectorOperations::copy(
+        monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
+        tempIncomingBuffer.getReadPointer(0, 0),
+        size);
 
-    while (channelFifo->getNumCompleteBuffersAvailable() > 0) {
-        if (channelFifo->getAudioBuffer(tempIncomingBuffer)) {
-            auto size = tempIncomingBuffer.getNumSamples();
+    return true;
+}
+
+void PathProducer::allocate() {
+    channelFFTDataGenerator.changeOrder(FFTOrder::order2048);
+    monoBuffer.setSize(1, channelFFTDataGenerator.getFFTSize());
+    monoBuffer.clear();
+
+    //the multi-resolution analyzer is left to processMultiResolution(), which
+    //prepares it on first use, so an instance that never turns it on never holds it
+}
+
+void PathProducer::releaseMultiResolution() {
+    multiResolutionAnalyzer.release();
+}
+
+void PathProducer::release() {
+    channelFFTDataGenerator.release();
+    multiResolutionAnalyzer.release();
+    pathProducer.release();
+    spectrogramFifo.release();
+
+    monoBuffer = juce::AudioBuffer<float>();
+    tempIncomingBuffer = juce::AudioBuffer<float>();
+    logSpectrum = {};
+    fftFrame = {};
+    spectrogramColumn = {};
+    channelFFTPath = Polyline();
+}
+
+size_t PathProducer::getAllocatedBytes() const {
+    return channelFFTDataGenerator.getAllocatedBytes() + multiResolutionAnalyzer.getAllocatedBytes()
+        + pathProducer.getAllocatedBytes() + spectrogramFifo.getAllocatedBytes()
+        + getHeapBytes(monoBuffer) + getHeapBytes(tempIncomingBuffer)
+        + getHeapBytes(logSpectrum) + getHeapBytes(fftFrame) + getHeapBytes(spectrogramColumn)
+        + channelFFTPath.getAllocatedBytes();
+}
 
-            juce::FloatVectorOperations::copy(
-                monoBuffer.getWritePointer(0, 0),
-                monoBuffer.getReadPointer(0, size),
-                monoBuffer.getNumSamples() - size);
+void PathProducer::setSmoothing(SpectrumSmoother::Smoothing smoothing, SpectrumSmoother::Averaging averaging, float decaySeconds) {
+    auto& smoother = channelFFTDataGenerator.getSmoother();
+    smoother.setSmoothing(smoothing);
+    smoother.setAveraging(averaging, decaySeconds);
 
-            juce::FloatVectorOperations::copy(
-                monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                tempIncomingBuffer.getReadPointer(0, 0),
-                size);
+    multiResolutionAnalyzer.setSmoothing(smoothing, averaging, decaySeconds);
+}
 
-            //send buffer to fft data generator 
-            channelFFTDataGenerator.ProduceFFTDataToRendering(monoBuffer, -48.f);
+void PathProducer::process() {
+    EQ_TRACE_SCOPE("PathProducer::process");
+    while (pullNextBuffer()) {
+        //send buffer to fft data generator 
+        channelFFTDataGenerator.ProduceFFTDataToRendering(monoBuffer, -48.f);
+    }
+
+    generatePaths();
+}
+
+void PathProducer::processPair(PathProducer& first, PathProducer& second) {
+    EQ_TRACE_SCOPE("PathProducer::processPair");
+    //both taps are fed block by block from the same processBlock call, so
+    //their fifos advance in lockstep as long as a block is only pulled from
+    //one when the other has one too. A pull can then only fail when the taps
+    //were suspended in between, and rebuilding them empties both fifos
+    while (first.hasNextBuffer() && second.hasNextBuffer()) {
+        auto pulledFirst = first.pullNextBuffer();
+        if (!second.pullNextBuffer() || !pulledFirst)
+            break;
+
+        first.channelFFTDataGenerator.ProducePackedFFTDataToRendering(first.monoBuffer,
+            second.monoBuffer,
+            second.channelFFTDataGenerator,
+            -48.f);
+    }
+
+    first.generatePaths();
+    second.generatePaths();
+}
+
+void PathProducer::processMultiResolution() {
+    EQ_TRACE_SCOPE("PathProducer::processMultiResolution");
+    juce::Rectangle<float> fftBounds;
+    double sampleRate;
+    {
+        const juce::SpinLock::ScopedLockType sl(renderParametersLock);
+        fftBounds = renderBounds;
+        sampleRate = renderSampleRate;
+    }
+
+    if (multiResolutionAnalyzer.getSampleRate() != sampleRate)
+        multiResolutionAnalyzer.prepare(sampleRate, -48.f);
+
+    while (pullNextBuffer()) {
+        multiResolutionAnalyzer.push(tempIncomingBuffer.getReadPointer(0), tempIncomingBuffer.getNumSamples());
+    }
+
+    while (multiResolutionAnalyzer.getNumSpectraAvailable() > 0) {
+        if (multiResolutionAnalyzer.getSpectrum(logSpectrum)) {
+            pathProducer.generateLogPath(logSpectrum, fftBounds, -48.f);
+            pushSpectrogramColumn(logSpectrum, -48.f);
         }
     }
+}
+
+void PathProducer::generatePaths() {
+    juce::Rectangle<float> fftBounds;
+    double sampleRate;
+    {
+        const juce::SpinLock::ScopedLockType sl(renderParametersLock);
+        fftBounds = renderBounds;
+        sampleRate = renderSampleRate;
+    }
 
     /* if there are fft data buffers to pull
     *   if we can pull a buffer
@@ -227,12 +408,59 @@ void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
     const auto binWidth = sampleRate / (double)fftSize; // 48000 / 2048 = 23Hz
 
     while (channelFFTDataGenerator.getNumAvailableFFTDBlocks() > 0) {
-        std::vector<float> fftData;
-        if (channelFFTDataGenerator.getFFTData(fftData)) {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+        if (channelFFTDataGenerator.getFFTData(fftFrame)) {
+            pathProducer.generatePath(fftFrame, fftBounds, fftSize, binWidth, -48.f);
+            pushSpectrogramColumn(fftFrame, fftSize / 2, binWidth, -48.f);
         }
     }
+}
+
+void PathProducer::pushSpectrogramColumn(const std::vector<float>& renderData, int numBins, float binWidth, float negativeInfinity) {
+    auto numRows = spectrogramRows.load();
+    if (numRows <= 0)
+        return;
+
+    spectrogramColumn.resize(numRows);
+
+    //same log mapping as the analyzer path, turned on its side: each row shows
+    //the loudest bin falling inside its frequency span
+    for (int row = 0; row < numRows; ++row) {
+        auto upper = juce::mapToLog10(1.f - float(row) / float(numRows), 20.f, 20000.f);
+        auto lower = juce::mapToLog10(1.f - float(row + 1) / float(numRows), 20.f, 20000.f);
+
+        auto firstBin = juce::jlimit(0, numBins - 1, (int)(lower / binWidth));
+        auto lastBin = juce::jlimit(firstBin, numBins - 1, (int)(upper / binWidth));
+
+        auto level = renderData[firstBin];
+        for (int bin = firstBin + 1; bin <= lastBin; ++bin)
+            level = juce::jmax(level, renderData[bin]);
+
+        spectrogramColumn[row] = juce::jlimit(0.f, 1.f, juce::jmap(level, negativeInfinity, 0.f, 0.f, 1.f));
+    }
+
+    spectrogramFifo.pushSwap(spectrogramColumn);
+}
+
+void PathProducer::pushSpectrogramColumn(const std::vector<float>& logSpectrum, float negativeInfinity) {
+    auto numRows = spectrogramRows.load();
+    if (numRows <= 0)
+        return;
 
+    spectrogramColumn.resize(numRows);
+
+    //the log spectrum is already spaced like the rows
+    auto numPoints = (int)logSpectrum.size();
+    for (int row = 0; row < numRows; ++row) {
+        auto position = 1.f - (float(row) + 0.5f) / float(numRows);
+        auto level = logSpectrum[juce::roundToInt(position * float(numPoints - 1))];
+
+        spectrogramColumn[row] = juce::jlimit(0.f, 1.f, juce::jmap(level, negativeInfinity, 0.f, 0.f, 1.f));
+    }
+
+    spectrogramFifo.pushSwap(spectrogramColumn);
+}
+
+void PathProducer::pullLatestPath() {
     /* while there are paths that can be pull
     *   pull as many as we can
     *       display the most recent path */
@@ -243,6 +471,64 @@ void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 
 //==============================================================================
 
+void SpectrogramImage::setSize(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        release();
+        return;
+    }
+
+    if (image.isValid() && image.getWidth() == width && image.getHeight() == height)
+        return;
+
+    image = juce::Image(juce::Image::RGB, width, height, true);
+    writeX = 0;
+}
+
+void SpectrogramImage::addColumn(const std::vector<float>& levels) {
+    if (!image.isValid() || (int)levels.size() != image.getHeight())
+        return;
+
+    auto& lut = getColourLUT();
+
+    juce::Image::BitmapData data(image, writeX, 0, 1, image.getHeight(), juce::Image::BitmapData::writeOnly);
+    for (int row = 0; row < image.getHeight(); ++row)
+        data.setPixelColour(0, row, lut[juce::jlimit(0, 255, (int)(levels[row] * 255.f))]);
+
+    writeX = (writeX + 1) % image.getWidth();
+}
+
+void SpectrogramImage::draw(juce::Graphics& g, juce::Rectangle<int> area) const {
+    if (!image.isValid())
+        return;
+
+    auto height = image.getHeight();
+    auto olderWidth = image.getWidth() - writeX;
+
+    g.drawImage(image, area.getX(), area.getY(), olderWidth, height, writeX, 0, olderWidth, height);
+
+    if (writeX > 0)
+        g.drawImage(image, area.getX() + olderWidth, area.getY(), writeX, height, 0, 0, writeX, height);
+}
+
+const std::array<juce::Colour, 256>& SpectrogramImage::getColourLUT() {
+    static const auto lut = [] {
+        std::array<juce::Colour, 256> colours;
+
+        juce::ColourGradient gradient(juce::Colours::black, 0.f, 0.f, juce::Colours::white, 1.f, 0.f, false);
+        gradient.addColour(0.4, juce::Colour(97u, 18u, 167u));
+        gradient.addColour(0.75, juce::Colour(255u, 176u, 0u));
+
+        for (int i = 0; i < (int)colours.size(); ++i)
+            colours[i] = gradient.getColourAtPosition(i / 255.0);
+
+        return colours;
+    }();
+
+    return lut;
+}
+
+//==============================================================================
+
 ResponseCurveComponent::ResponseCurveComponent(EQAudioProcessor& p) : 
     audioProcessor(p), 
     leftPathProducer(audioProcessor.leftChannelFifo),
@@ -253,28 +539,72 @@ ResponseCurveComponent::ResponseCurveComponent(EQAudioProcessor& p) :
         param->addListener(this);
     }
 
-    updateChain();
-
-    startTimerHz(60);
+    shouldShowFFTAnalysis = audioProcessor.parameterCache.get(ParameterId::AnalyzerEnabled) > 0.5f;
 }
 ResponseCurveComponent::~ResponseCurveComponent() {
+    analysisService->removeClient(this);
+
+    if (analyzerAllocated.load())
+        audioProcessor.removeAnalyzerListener(*this);
+
+    audioProcessor.setEditorAnalyzerBytes(0);
+
     const auto& params = audioProcessor.getParameters();
     for (auto param : params) {
         param->removeListener(this);
     }
 }
 
+void ResponseCurveComponent::start() {
+    started = true;
+
+    updateChain();
+    updateResponseCurve();
+
+    analysisService->addClient(this);
+    updateAnalyzerStorage();
+
+    startTimerHz(60);
+}
+
 void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float newValue) {
     parametersChanged.set(true);
 }
 
 void ResponseCurveComponent::timerCallback() {
+    updateAnalyzerStorage();
+    updateAnalysisState();
+
     if (shouldShowFFTAnalysis) {
         auto fftBounds = getAnalysisArea().toFloat();
         auto sampleRate = audioProcessor.getSampleRate();
 
-        leftPathProducer.process(fftBounds, sampleRate);
-        rightPathProducer.process(fftBounds, sampleRate);
+        leftPathProducer.setRenderParameters(fftBounds, sampleRate);
+        rightPathProducer.setRenderParameters(fftBounds, sampleRate);
+
+        leftPathProducer.pullLatestPath();
+        rightPathProducer.pullLatestPath();
+    }
+
+    updateSpectrogramState();
+
+    if (spectrogram.isAllocated()) {
+        //both taps advance in lockstep, the louder of the two is shown
+        while (leftPathProducer.getNumSpectrogramColumnsAvailable() > 0 &&
+            rightPathProducer.getNumSpectrogramColumnsAvailable() > 0)
+        {
+            if (!leftPathProducer.getSpectrogramColumn(leftSpectrogramColumn) ||
+                !rightPathProducer.getSpectrogramColumn(rightSpectrogramColumn))
+                break;
+
+            if (leftSpectrogramColumn.size() == rightSpectrogramColumn.size())
+                juce::FloatVectorOperations::max(leftSpectrogramColumn.data(),
+                    leftSpectrogramColumn.data(),
+                    rightSpectrogramColumn.data(),
+                    (int)leftSpectrogramColumn.size());
+
+            spectrogram.addColumn(leftSpectrogramColumn);
+        }
     }
     
     if (parametersChanged.compareAndSetBool(false, true)) {
@@ -286,64 +616,119 @@ void ResponseCurveComponent::timerCallback() {
     repaint();
 }
 
-void ResponseCurveComponent::updateChain() {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+void ResponseCurveComponent::runAnalysis() {
+    if (!analyzerAllocated.load())
+        return;
+
+    if (multiResolutionAnalysis.load()) {
+        leftPathProducer.processMultiResolution();
+        rightPathProducer.processMultiResolution();
+    }
+    else if (packedAnalysis.load()) {
+        PathProducer::processPair(leftPathProducer, rightPathProducer);
+    }
+    else {
+        leftPathProducer.process();
+        rightPathProducer.process();
+    }
+}
 
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+void ResponseCurveComponent::updateAnalysisState() {
+    auto visible = shouldShowFFTAnalysis && isShowing();
 
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    auto priority = AnalysisService::Priority::Normal;
+    if (auto* peer = getPeer())
+        priority = peer->isFocused() ? AnalysisService::Priority::Foreground : AnalysisService::Priority::Normal;
+
+    setAnalysisState(visible, priority);
+}
+
+void ResponseCurveComponent::updateAnalyzerStorage() {
+    if (shouldShowFFTAnalysis == analyzerAllocated.load())
+        return;
+
+    if (shouldShowFFTAnalysis) {
+        //listener first, so the taps exist before anything reads them
+        audioProcessor.addAnalyzerListener(*this);
+
+        leftPathProducer.allocate();
+        rightPathProducer.allocate();
+
+        analyzerAllocated.store(true);
+    }
+    else {
+        //no worker may touch the producers while they are freed
+        analyzerAllocated.store(false);
+        analysisService->pauseClient(this);
+
+        leftPathProducer.release();
+        rightPathProducer.release();
+
+        audioProcessor.removeAnalyzerListener(*this);
+    }
+
+    publishAnalyzerBytes();
+}
+
+void ResponseCurveComponent::setMultiResolutionAnalysis(bool shouldUse) {
+    if (multiResolutionAnalysis.exchange(shouldUse) == shouldUse || shouldUse || !analyzerAllocated.load())
+        return;
+
+    //a worker may still be inside processMultiResolution() until it is paused
+    analysisService->pauseClient(this);
+
+    leftPathProducer.releaseMultiResolution();
+    rightPathProducer.releaseMultiResolution();
+
+    updateAnalysisState();
+    publishAnalyzerBytes();
+}
+
+void ResponseCurveComponent::publishAnalyzerBytes() {
+    //measured when the storage changes (the workers may be filling the paths
+    //at any other time), so later growth of the paths isn't counted
+    audioProcessor.setEditorAnalyzerBytes(leftPathProducer.getAllocatedBytes() + rightPathProducer.getAllocatedBytes()
+        + spectrogram.getAllocatedBytes() + curveRasteriser.getAllocatedBytes());
+}
+
+void ResponseCurveComponent::updateSpectrogramState() {
+    auto area = getAnalysisArea();
+    auto wanted = showSpectrogram && shouldShowFFTAnalysis && isShowing() && !area.isEmpty();
+
+    auto previousBytes = spectrogram.getAllocatedBytes();
+
+    if (wanted)
+        spectrogram.setSize(area.getWidth(), area.getHeight());
+    else
+        spectrogram.release();
+
+    if (spectrogram.getAllocatedBytes() != previousBytes)
+        publishAnalyzerBytes();
+
+    auto rows = spectrogram.isAllocated() ? area.getHeight() : 0;
+    leftPathProducer.setSpectrogramRows(rows);
+    rightPathProducer.setSpectrogramRows(rows);
+}
+
+void ResponseCurveComponent::updateChain() {
+    updateMonoChain(monoChain, getChainSettings(audioProcessor.parameterCache), audioProcessor.getSampleRate());
 }
 
 void ResponseCurveComponent::updateResponseCurve() {
+    EQ_TRACE_SCOPE("updateResponseCurve");
     using namespace juce;
 
     auto responseArea = getAnalysisArea();
 
     auto w = responseArea.getWidth();
 
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
-
     auto sampleRate = audioProcessor.getSampleRate();
 
     std::vector<double> mags;
     mags.resize(w);
     for (int i = 0; i < w; ++i) {
-        double mag = 1.f;
         auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
-
-        if (!monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-
-        if (!monoChain.isBypassed<ChainPositions::LowCut>()) {
-            if (!lowcut.isBypassed<0>())
-                mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<1>())
-                mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<2>())
-                mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<3>())
-                mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-
-        if (!monoChain.isBypassed<ChainPositions::HighCut>()) {
-            if (!highcut.isBypassed<0>())
-                mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<1>())
-                mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<2>())
-                mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<3>())
-                mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
+        auto mag = getChainMagnitude(monoChain, freq, sampleRate);
 
         mags[i] = Decibels::gainToDecibels(mag);
     }
@@ -364,30 +749,38 @@ void ResponseCurveComponent::updateResponseCurve() {
 
 void ResponseCurveComponent::paint(juce::Graphics& g)
 {
+    EQ_TRACE_THREAD_NAME("Message");
+    EQ_TRACE_SCOPE("ResponseCurveComponent::paint");
     using namespace juce;
+
+    if (!started)
+        start();
+
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll(Colours::black);
 
-    drawBackgroundGrid(g);
-
     auto responseArea = getAnalysisArea();
 
-    if (shouldShowFFTAnalysis) {
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+    if (shouldShowFFTAnalysis)
+        spectrogram.draw(g, responseArea);
 
-        g.setColour(Colours::skyblue);
-        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
+    drawBackgroundGrid(g);
 
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-        rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+    //all curves are rasterised into one reused image covering the render area
+    auto renderArea = getRenderArea();
+    curveRasteriser.setSize(renderArea.getWidth(), renderArea.getHeight());
+    curveRasteriser.clear();
 
-        g.setColour(Colours::lightyellow);
-        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
+    if (shouldShowFFTAnalysis) {
+        auto analyzerOffset = responseArea.getPosition() - renderArea.getPosition();
+
+        curveRasteriser.drawCurve(leftPathProducer.getPath(), Colours::skyblue, 1.f, analyzerOffset);
+        curveRasteriser.drawCurve(rightPathProducer.getPath(), Colours::lightyellow, 1.f, analyzerOffset);
     }
 
-    g.setColour(Colours::whitesmoke);
-    g.strokePath(responseCurve, PathStrokeType(2.f));
+    curveRasteriser.drawCurve(responseCurve, Colours::whitesmoke, 2.f, -renderArea.getPosition());
+
+    g.drawImageAt(curveRasteriser.getImage(), renderArea.getX(), renderArea.getY());
 
     Path border;
     border.setUsingNonZeroWinding(false);
@@ -407,7 +800,12 @@ void ResponseCurveComponent::resized() {
     using namespace juce;
     
     responseCurve.preallocateSpace(getWidth() * 3);
-    updateResponseCurve();
+
+    //before the first paint there is no filter design to draw yet
+    if (started) {
+        updateResponseCurve();
+        updateSpectrogramState();
+    }
 }
 
 void ResponseCurveComponent::drawBackgroundGrid(juce::Graphics& g) {
@@ -452,7 +850,6 @@ void ResponseCurveComponent::drawTextLabels(juce::Graphics& g) {
 
     g.setColour(Colours::lightgrey);
     const int fontHeight = 10;
-    g.setFont(fontHeight);
 
     for (int i = 0; i < freqs.size(); ++i) {
         auto f = freqs[i];
@@ -469,14 +866,14 @@ void ResponseCurveComponent::drawTextLabels(juce::Graphics& g) {
             str << "k";
         str << "Hz";
 
-        auto textWidth = g.getCurrentFont().getStringWidth(str);
+        auto textWidth = glyphCache->getWidth(str, fontHeight);
 
-        Rectangle<int> r;
+        Rectangle<float> r;
         r.setSize(textWidth, fontHeight);
         r.setCentre(x, 0);
         r.setY(1);
 
-        g.drawFittedText(str, r, Justification::centred, 1);
+        glyphCache->draw(g, str, fontHeight, r, Justification::centred);
     }
 
     for (auto gDb : gain) {
@@ -487,24 +884,24 @@ void ResponseCurveComponent::drawTextLabels(juce::Graphics& g) {
             str << "+";
         str << gDb;
 
-        auto textWidth = g.getCurrentFont().getStringWidth(str);
+        auto textWidth = glyphCache->getWidth(str, fontHeight);
 
-        Rectangle<int> r;
+        Rectangle<float> r;
         r.setSize(textWidth, fontHeight);
         r.setX(getWidth() - textWidth);
         r.setCentre(r.getCentreX(), y);
 
         g.setColour(gDb == 0.f ? Colour(0u, 172u, 1u) : Colours::lightgrey);
-        g.drawFittedText(str, r, Justification::centred, 1);
+        glyphCache->draw(g, str, fontHeight, r, Justification::centred);
 
         str.clear();
         str << (gDb - 24.f);
 
         r.setX(1);
-        textWidth = g.getCurrentFont().getStringWidth(str);
+        textWidth = glyphCache->getWidth(str, fontHeight);
         r.setSize(textWidth, fontHeight);
         g.setColour(Colours::lightgrey);
-        g.drawFittedText(str, r, Justification::centred, 1);
+        glyphCache->draw(g, str, fontHeight, r, Justification::centred);
     }
 }
 
@@ -556,27 +953,27 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea() {
 
 EQAudioProcessorEditor::EQAudioProcessorEditor (EQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p), 
-    peakFreqSlider (*audioProcessor.apvts.getParameter("Peak Freq"), "Hz"),
-    peakGainSlider (*audioProcessor.apvts.getParameter("Peak Gain"), "dB"),
-    peakQualitySlider (*audioProcessor.apvts.getParameter("Peak Quality"), ""),
-    lowCutFreqSlider (*audioProcessor.apvts.getParameter("LowCut Freq"), "Hz"),
-    highCutFreqSlider (*audioProcessor.apvts.getParameter("HighCut Freq"), "Hz"),
-    lowCutSlopeSlider (*audioProcessor.apvts.getParameter("LowCut Slope"), "dB/Oct"),
-    highCutSlopeSlider (*audioProcessor.apvts.getParameter("HighCut Slope"), "dB/Oct"),
+    peakFreqSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::PeakFreq)), "Hz"),
+    peakGainSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::PeakGain)), "dB"),
+    peakQualitySlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::PeakQuality)), ""),
+    lowCutFreqSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::LowCutFreq)), "Hz"),
+    highCutFreqSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::HighCutFreq)), "Hz"),
+    lowCutSlopeSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::LowCutSlope)), "dB/Oct"),
+    highCutSlopeSlider (*audioProcessor.apvts.getParameter(getParameterID(ParameterId::HighCutSlope)), "dB/Oct"),
 
     responseCurveComponent (audioProcessor),
-    peakFreqSliderAttachment (audioProcessor.apvts, "Peak Freq", peakFreqSlider),
-    peakGainSliderAttachment (audioProcessor.apvts, "Peak Gain", peakGainSlider),
-    peakQualitySliderAttachment (audioProcessor.apvts, "Peak Quality", peakQualitySlider),
-    lowCutFreqSliderAttachment (audioProcessor.apvts, "LowCut Freq", lowCutFreqSlider),
-    highCutFreqSliderAttachment (audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
-    lowCutSlopeSliderAttachment (audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlider),
-    highCutSlopeSliderAttachment (audioProcessor.apvts, "HighCut Slope", highCutSlopeSlider),
-
-    lowcutBypassButtonAttachment (audioProcessor.apvts, "LowCut Bypassed", lowcutBypassButton),
-    peakBypassButtonAttachment (audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
-    highcutBypassButtonAttachment (audioProcessor.apvts, "HighCut Bypassed", highcutBypassButton),
-    analyzerEnabledButtonAttachment (audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton)
+    peakFreqSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::PeakFreq), peakFreqSlider),
+    peakGainSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::PeakGain), peakGainSlider),
+    peakQualitySliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::PeakQuality), peakQualitySlider),
+    lowCutFreqSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::LowCutFreq), lowCutFreqSlider),
+    highCutFreqSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::HighCutFreq), highCutFreqSlider),
+    lowCutSlopeSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::LowCutSlope), lowCutSlopeSlider),
+    highCutSlopeSliderAttachment (audioProcessor.apvts, getParameterID(ParameterId::HighCutSlope), highCutSlopeSlider),
+
+    lowcutBypassButtonAttachment (audioProcessor.apvts, getParameterID(ParameterId::LowCutBypassed), lowcutBypassButton),
+    peakBypassButtonAttachment (audioProcessor.apvts, getParameterID(ParameterId::PeakBypassed), peakBypassButton),
+    highcutBypassButtonAttachment (audioProcessor.apvts, getParameterID(ParameterId::HighCutBypassed), highcutBypassButton),
+    analyzerEnabledButtonAttachment (audioProcessor.apvts, getParameterID(ParameterId::AnalyzerEnabled), analyzerEnabledButton)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -606,10 +1003,11 @@ EQAudioProcessorEditor::EQAudioProcessorEditor (EQAudioProcessor& p)
         addAndMakeVisible(components);
     }
 
-    peakBypassButton.setLookAndFeel(&lnf);
-    lowcutBypassButton.setLookAndFeel(&lnf);
-    highcutBypassButton.setLookAndFeel(&lnf);
-    analyzerEnabledButton.setLookAndFeel(&lnf);
+    peakBypassButton.setLookAndFeel(lnf);
+    lowcutBypassButton.setLookAndFeel(lnf);
+    highcutBypassButton.setLookAndFeel(lnf);
+    analyzerEnabledButton.setLookAndFeel(lnf);
+    spectrogramButton.setLookAndFeel(lnf);
 
     auto safePtr = juce::Component::SafePointer<EQAudioProcessorEditor>(this);
     peakBypassButton.onClick = [safePtr]() {
@@ -649,6 +1047,18 @@ EQAudioProcessorEditor::EQAudioProcessorEditor (EQAudioProcessor& p)
         }
     };
 
+    spectrogramButton.onClick = [safePtr]() {
+        if (auto* component = safePtr.getComponent()) {
+            auto visible = component->spectrogramButton.getToggleState();
+
+            component->responseCurveComponent.setSpectrogramVisible(visible);
+        }
+    };
+
+#if EQ_TRACING
+    setWantsKeyboardFocus(true);
+#endif
+
     setSize (600, 500);
 }
 EQAudioProcessorEditor::~EQAudioProcessorEditor()
@@ -657,21 +1067,46 @@ EQAudioProcessorEditor::~EQAudioProcessorEditor()
     lowcutBypassButton.setLookAndFeel(nullptr);
     highcutBypassButton.setLookAndFeel(nullptr);
     analyzerEnabledButton.setLookAndFeel(nullptr);
+    spectrogramButton.setLookAndFeel(nullptr);
 }
 
 void EQAudioProcessorEditor::paint (juce::Graphics& g)
 {
+    EQ_TRACE_SCOPE("EQAudioProcessorEditor::paint");
     using namespace juce;
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (Colours::black);
 
     g.setColour(Colours::grey);
-    g.setFont(14);
-    g.drawFittedText("LowCut", lowCutSlopeSlider.getBounds(), Justification::centredBottom, 1);
-    g.drawFittedText("Peak", peakQualitySlider.getBounds(), Justification::centredBottom, 1);
-    g.drawFittedText("HighCut", highCutSlopeSlider.getBounds(), Justification::centredBottom, 1);
+    glyphCache->draw(g, "LowCut", 14.f, lowCutSlopeSlider.getBounds().toFloat(), Justification::centredBottom);
+    glyphCache->draw(g, "Peak", 14.f, peakQualitySlider.getBounds().toFloat(), Justification::centredBottom);
+    glyphCache->draw(g, "HighCut", 14.f, highCutSlopeSlider.getBounds().toFloat(), Justification::centredBottom);
+}
+
+void EQAudioProcessorEditor::paintOverChildren(juce::Graphics&)
+{
+    if (firstFrameReported)
+        return;
+
+    firstFrameReported = true;
+
+    auto elapsedTicks = juce::Time::getHighResolutionTicks() - constructionStartTicks;
+    auto milliseconds = juce::Time::highResolutionTicksToSeconds(elapsedTicks) * 1000.0;
+    audioProcessor.setEditorFirstFrameTime(milliseconds);
 }
 
+#if EQ_TRACING
+bool EQAudioProcessorEditor::keyPressed(const juce::KeyPress& key)
+{
+    if (key == juce::KeyPress('t', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0)) {
+        writeTraceFile(getTraceFile());
+        return true;
+    }
+
+    return false;
+}
+#endif
+
 void EQAudioProcessorEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
@@ -685,6 +1120,8 @@ void EQAudioProcessorEditor::resized()
     analyzerEnabledArea.removeFromTop(2);
     analyzerEnabledButton.setBounds(analyzerEnabledArea);
 
+    spectrogramButton.setBounds(analyzerEnabledArea.withX(analyzerEnabledArea.getRight() + 5));
+
     bounds.removeFromTop(5);
 
     float hRation = 25.f / 100.f; // JUCE_LIVE_CONSTANT(33)
@@ -725,6 +1162,7 @@ std::vector<juce::Component*> EQAudioProcessorEditor::getComponents() {
         &lowcutBypassButton,
         &peakBypassButton,
         &highcutBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        &spectrogramButton
     };
 }
\ No newline at end of file
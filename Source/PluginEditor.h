@@ -9,7 +9,14 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <map>
+#include <tuple>
 #include "PluginProcessor.h"
+#include "AnalysisService.h"
+#include "MultiResolutionAnalyzer.h"
+#include "CurveRenderer.h"
+#include "GlyphCache.h"
+#include "SpectrumSmoother.h"
 
 enum FFTOrder {
     order2048 = 11,
@@ -31,51 +38,146 @@ struct FFTDataGenerator {
         window->multiplyWithWindowingTable (fftData.data(), fftSize); // [1]
 
         //render fft data
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data()); // [2]
+        {
+            EQ_TRACE_SCOPE("FFT");
+            forwardFFT->performFrequencyOnlyForwardTransform (fftData.data()); // [2]
+        }
 
-        int numBins = (int)fftSize / 2;
+        pushMagnitudes(negativeInfinity);
+    }
 
-        //normalize fft values
-        for (int i = 0; i < numBins; ++i) {
-            //fftData[i] /= (float)numBins;
-            auto nv = fftData[i];
-            if (!std::isinf(nv) && !std::isnan(nv))
-                nv /= float(numBins);
-            else
-                nv = 0.f;
-            fftData[i] = nv;
+    /*  produces the fft data of two buffers with one complex FFT: 'audioData' goes
+        into the real part and 'otherAudioData' into the imaginary part. With
+        Z = FFT(x + iy), X[k] = (Z[k] + conj(Z[N-k])) / 2 and Y[k] = (Z[k] - conj(Z[N-k])) / 2i,
+        so the spectra match two real-only transforms. The first spectrum is
+        pushed to this generator, the second to 'other'. */
+    void ProducePackedFFTDataToRendering(const juce::AudioBuffer<float>& audioData,
+        const juce::AudioBuffer<float>& otherAudioData,
+        FFTDataGenerator& other,
+        const float negativeInfinity)
+    {
+        jassert(other.getFFTSize() == getFFTSize());
+        const auto fftSize = getFFTSize();
+
+        fftData.assign(fftData.size(), 0);
+        other.fftData.assign(other.fftData.size(), 0);
+
+        auto* readIndex = audioData.getReadPointer(0);
+        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        readIndex = otherAudioData.getReadPointer(0);
+        std::copy(readIndex, readIndex + fftSize, other.fftData.begin());
+
+        window->multiplyWithWindowingTable(fftData.data(), fftSize);
+        window->multiplyWithWindowingTable(other.fftData.data(), fftSize);
+
+        for (int i = 0; i < fftSize; ++i)
+            packedInput[i] = { fftData[i], other.fftData[i] };
+
+        {
+            EQ_TRACE_SCOPE("FFT (packed)");
+            forwardFFT->perform(packedInput.data(), packedOutput.data(), false);
         }
 
-        //convert to decibels
-        for (int i = 0; i < numBins; ++i) {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+        int numBins = (int)fftSize / 2;
+
+        for (int k = 0; k < numBins; ++k) {
+            auto z = packedOutput[k];
+            auto zMirror = std::conj(packedOutput[(fftSize - k) & (fftSize - 1)]);
+
+            fftData[k] = std::abs(z + zMirror) * 0.5f;
+            other.fftData[k] = std::abs(z - zMirror) * 0.5f;
         }
 
-        fftDataFifo.push(fftData);
+        pushMagnitudes(negativeInfinity);
+        other.pushMagnitudes(negativeInfinity);
     }
 
     void changeOrder(FFTOrder newOrder) {
         order = newOrder;
         auto fftSize = getFFTSize();
 
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
+        forwardFFT = &analysisService->getFFT(order);
+        window = &analysisService->getWindow(fftSize);
 
         fftData.clear();
         fftData.resize(fftSize * 2, 0);
 
+        packedInput.resize(fftSize);
+        packedOutput.resize(fftSize);
+
+        smoother.prepare(fftSize / 2);
+
         fftDataFifo.prepare(fftData.size());
     }
 
+    //frees everything changeOrder() allocated; call it again before producing
+    void release() {
+        fftData = BlockType();
+        packedInput = {};
+        packedOutput = {};
+        smoother.release();
+        fftDataFifo.release();
+    }
+
+    size_t getAllocatedBytes() const {
+        return getHeapBytes(fftData) + (packedInput.capacity() + packedOutput.capacity()) * sizeof(juce::dsp::Complex<float>)
+            + smoother.getAllocatedBytes() + fftDataFifo.getAllocatedBytes();
+    }
+
     int getFFTSize() const { return 1 << order; }
     int getNumAvailableFFTDBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
 
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    //a correctly sized 'data' is swapped in rather than copied
+    bool getFFTData(BlockType& data) {
+        if (data.size() == fftData.size())
+            return fftDataFifo.pullSwap(data);
+
+        return fftDataFifo.pull(data);
+    }
+
+    int getNumDroppedFFTBlocks() const { return fftDataFifo.getNumDroppedPushes(); }
+
+    //smoothing and averaging applied to every frame before the decibel conversion
+    SpectrumSmoother& getSmoother() { return smoother; }
+    //time between frames, used by the temporal averaging
+    void setFramePeriod(float seconds) { framePeriod = seconds; }
 private:
+    //normalizes the magnitudes in fftData[0, numBins), converts them to decibels and pushes them
+    void pushMagnitudes(const float negativeInfinity) {
+        int numBins = (int)getFFTSize() / 2;
+
+        //normalize fft values
+        for (int i = 0; i < numBins; ++i) {
+            //fftData[i] /= (float)numBins;
+            auto nv = fftData[i];
+            if (!std::isinf(nv) && !std::isnan(nv))
+                nv /= float(numBins);
+            else
+                nv = 0.f;
+            fftData[i] = nv;
+        }
+
+        smoother.process(fftData.data(), numBins, framePeriod);
+
+        //convert to decibels
+        for (int i = 0; i < numBins; ++i) {
+            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+        }
+
+        //fftData comes back as a recycled block of the same size
+        fftDataFifo.pushSwap(fftData);
+    }
+
+    SpectrumSmoother smoother;
+    float framePeriod = 0.01f;
+
     FFTOrder order;
     BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<juce::dsp::Complex<float>> packedInput, packedOutput;
+    //the plan and window are shared with every other generator in the process
+    juce::SharedResourcePointer<AnalysisService> analysisService;
+    juce::dsp::FFT* forwardFFT = nullptr;
+    juce::dsp::WindowingFunction<float>* window = nullptr;
 
     Fifo<BlockType> fftDataFifo;
 };
@@ -84,20 +186,22 @@ private:
 
 template<typename PathType>
 struct AnalyzerPathGenerator {
-    //converts 'renderData[]' into a juce::Path
+    //converts 'renderData[]' into a juce::Path or Polyline
     void generatePath(const std::vector<float>& renderData,
         juce::Rectangle<float> fftBounds,
         int fftSize,
         float binWidth,
         float negativeInfinity) 
     {
+        EQ_TRACE_SCOPE("generatePath");
         auto top = fftBounds.getY();
         auto bottom = fftBounds.getHeight();
         auto width = fftBounds.getWidth();
 
         int numBins = (int)fftSize / 2;
 
-        PathType p;
+        auto& p = path;
+        p.clear();
         p.preallocateSpace(3 * (int)fftBounds.getWidth());
 
         auto map = [bottom, top, negativeInfinity](float v) {
@@ -125,18 +229,100 @@ struct AnalyzerPathGenerator {
                 p.lineTo(binX, y);
             }
         }
-        pathFifo.push(p);
+        pathFifo.pushSwap(p);
+    }
+
+    //converts a log-frequency spectrum (points spread evenly across 20Hz - 20kHz) into a juce::Path or Polyline
+    void generateLogPath(const std::vector<float>& renderData,
+        juce::Rectangle<float> fftBounds,
+        float negativeInfinity)
+    {
+        EQ_TRACE_SCOPE("generateLogPath");
+        auto top = fftBounds.getY();
+        auto bottom = fftBounds.getHeight();
+        auto width = fftBounds.getWidth();
+
+        auto numPoints = (int)renderData.size();
+
+        auto& p = path;
+        p.clear();
+        p.preallocateSpace(3 * numPoints);
+
+        auto map = [bottom, top, negativeInfinity](float v) {
+            return juce::jmap(v,
+                negativeInfinity, 0.f,
+                float(bottom + 7), top);
+        };
+
+        auto y = map(renderData[0]);
+
+        if (std::isnan(y) || std::isinf(y))
+            y = bottom;
+
+        p.startNewSubPath(0, y);
+
+        for (int i = 1; i < numPoints; ++i) {
+            y = map(renderData[i]);
+
+            if (!std::isnan(y) && !std::isinf(y))
+                p.lineTo(width * float(i) / float(numPoints - 1), y);
+        }
+        pathFifo.pushSwap(p);
     }
 
     int getNumPathsAvailable() const { return pathFifo.getNumAvailableForReading(); }
 
-    bool getPath(PathType& path) { return pathFifo.pull(path); }
+    //the caller's previous path goes back into the fifo to be refilled
+    bool getPath(PathType& pathToFill) { return pathFifo.pullSwap(pathToFill); }
+
+    int getNumDroppedPaths() const { return pathFifo.getNumDroppedPushes(); }
+
+    void release() {
+        pathFifo.release();
+        path = PathType();
+    }
+
+    size_t getAllocatedBytes() const { return pathFifo.getAllocatedBytes() + getHeapBytes(path); }
 private:
     Fifo<PathType> pathFifo;
+    //built in place, then swapped into the fifo for a recycled one
+    PathType path;
 };
 
 //==============================================================================
 
+/*  Knob bodies (disc, outline and pointer) pre-rendered at numFrames angle
+    steps, one strip per diameter, pixel scale and look. Frames are rendered
+    the first time a knob lands on them, so a strip only costs what its knobs
+    have actually shown. Message thread only. */
+struct KnobFilmstrips {
+    static constexpr int numFrames = 64;
+    //editors at many sizes would otherwise keep every size they ever drew
+    static constexpr size_t maxStrips = 16;
+    //frames extend past the knob so its outline isn't clipped
+    static constexpr int margin = 1;
+
+    struct Key {
+        int diameter;
+        float scale;
+        bool enabled;
+        float pointerInset, startAngle, endAngle;
+
+        bool operator<(const Key& other) const {
+            return std::tie(diameter, scale, enabled, pointerInset, startAngle, endAngle)
+                < std::tie(other.diameter, other.scale, other.enabled, other.pointerInset, other.startAngle, other.endAngle);
+        }
+    };
+
+    //the frame nearest to 'sliderPosProportional', 'diameter' * 'scale' pixels square
+    const juce::Image& getFrame(const Key& key, float sliderPosProportional);
+    void clear() { strips.clear(); }
+private:
+    std::map<Key, std::vector<juce::Image>> strips;
+};
+
+//stateless apart from the knob filmstrips, so every component in every
+//editor shares one instance through juce::SharedResourcePointer
 struct LookAndFeel : juce::LookAndFeel_V4 {
     void drawRotarySlider(juce::Graphics& g,
         int x, int y, int width, int height,
@@ -149,6 +335,21 @@ struct LookAndFeel : juce::LookAndFeel_V4 {
         juce::ToggleButton& toggleButton,
         bool shouldDrawButtonAsHighlighted,
         bool shouldDrawButtonAsDown) override;
+
+    //on by default: knob bodies are blitted from filmstrips and only the value
+    //text is drawn per repaint. Off draws every knob as vectors
+    void setKnobFilmstripsEnabled(bool shouldUse) {
+        useKnobFilmstrips = shouldUse;
+        if (!shouldUse)
+            knobFilmstrips.clear();
+    }
+
+    //the pointer runs from the rim to 'pointerInset' short of the centre
+    static void drawKnobBody(juce::Graphics& g, juce::Rectangle<float> bounds,
+        float angle, bool enabled, float pointerInset);
+private:
+    bool useKnobFilmstrips = true;
+    KnobFilmstrips knobFilmstrips;
 };
 
 //==============================================================================
@@ -160,7 +361,7 @@ struct RotarySliderWithLabels : juce::Slider {
         parameter(&rap),
         suffix(unitSuffix) 
     {
-        setLookAndFeel(&lnf);
+        setLookAndFeel(lnf);
     }
 
     ~RotarySliderWithLabels() {
@@ -179,7 +380,8 @@ struct RotarySliderWithLabels : juce::Slider {
     juce::String getDisplayString() const;
 
 private: 
-    LookAndFeel lnf;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
+    juce::SharedResourcePointer<GlyphCache> glyphCache;
     juce::RangedAudioParameter* parameter;
     juce::String suffix;
 };
@@ -188,52 +390,147 @@ private:
 
 struct PathProducer {
     PathProducer(SingleChannelSampleFifo<EQAudioProcessor::BlockType>& scsf) :
-        channelFifo(&scsf) {
-        channelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, channelFFTDataGenerator.getFFTSize());
+        channelFifo(&scsf) { }
+
+    //message thread, with no analysis running: the producer holds no storage
+    //until allocate() and none after release()
+    void allocate();
+    void release();
+    //frees the multi-resolution analyzer alone, processMultiResolution() prepares it again
+    void releaseMultiResolution();
+    size_t getAllocatedBytes() const;
+    //runs on an AnalysisService worker
+    void process();
+    //same as calling process() on both, but with one packed complex FFT per frame
+    static void processPair(PathProducer& first, PathProducer& second);
+    //finer lows at a lower cost than one large FFT, see MultiResolutionAnalyzer
+    void processMultiResolution();
+
+    //message thread, applies to both analysis modes
+    void setSmoothing(SpectrumSmoother::Smoothing smoothing, SpectrumSmoother::Averaging averaging, float decaySeconds);
+    //message thread
+    void setRenderParameters(juce::Rectangle<float> fftBounds, double sampleRate);
+    void pullLatestPath();
+    const Polyline& getPath() const { return channelFFTPath; }
+
+    //spectrogram feed: one column of levels (0..1, top row = 20kHz) per analysis frame, 0 rows turns it off
+    void setSpectrogramRows(int numRows) { spectrogramRows.store(numRows); }
+    int getNumSpectrogramColumnsAvailable() const { return spectrogramFifo.getNumAvailableForReading(); }
+    bool getSpectrogramColumn(std::vector<float>& column) { return spectrogramFifo.pullSwap(column); }
+
+    //frames lost because the message thread fell behind the analysis
+    int getNumDroppedFrames() const {
+        return channelFFTDataGenerator.getNumDroppedFFTBlocks() + pathProducer.getNumDroppedPaths()
+            + multiResolutionAnalyzer.getNumDroppedSpectra();
     }
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return channelFFTPath; }
+    int getNumDroppedInputBuffers() const { return channelFifo->getNumDroppedBuffers(); }
 private:
     SingleChannelSampleFifo<EQAudioProcessor::BlockType>* channelFifo;
 
+    juce::SpinLock renderParametersLock;
+    juce::Rectangle<float> renderBounds;
+    double renderSampleRate = 44100.0;
+
     juce::AudioBuffer<float> monoBuffer;
+    juce::AudioBuffer<float> tempIncomingBuffer;
+
+    bool hasNextBuffer() const { return channelFifo->isPrepared() && channelFifo->getNumCompleteBuffersAvailable() > 0; }
+    bool pullNextBuffer();
+    void generatePaths();
+
+    std::atomic<int> spectrogramRows { 0 };
+    Fifo<std::vector<float>> spectrogramFifo;
+    std::vector<float> spectrogramColumn;
+    void pushSpectrogramColumn(const std::vector<float>& renderData, int numBins, float binWidth, float negativeInfinity);
+    void pushSpectrogramColumn(const std::vector<float>& logSpectrum, float negativeInfinity);
 
     FFTDataGenerator<std::vector<float>> channelFFTDataGenerator;
+    MultiResolutionAnalyzer multiResolutionAnalyzer;
+    std::vector<float> logSpectrum, fftFrame;
 
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    AnalyzerPathGenerator<Polyline> pathProducer;
 
-    juce::Path channelFFTPath;
+    Polyline channelFFTPath;
+};
+
+//==============================================================================
+
+//scrolling history of analyzer frames, one column per frame written into a ring
+//of columns, so adding a frame never shifts or redraws the rest of the image
+struct SpectrogramImage {
+    //the width is the history length in frames
+    void setSize(int width, int height);
+    void release() { image = juce::Image(); writeX = 0; }
+    bool isAllocated() const { return image.isValid(); }
+    size_t getAllocatedBytes() const { return getImageBytes(image); }
+
+    void addColumn(const std::vector<float>& levels);
+    //two blits: oldest columns (from the write position on) first, then the wrapped newest ones
+    void draw(juce::Graphics& g, juce::Rectangle<int> area) const;
+private:
+    static const std::array<juce::Colour, 256>& getColourLUT();
+
+    juce::Image image;
+    int writeX = 0;
 };
 
 //==============================================================================
 
 struct ResponseCurveComponent : juce::Component, 
-    juce::AudioProcessorParameter::Listener, juce::Timer {
+    juce::AudioProcessorParameter::Listener, juce::Timer, AnalysisService::Client, AnalyzerTapReader {
     ResponseCurveComponent(EQAudioProcessor&);
     ~ResponseCurveComponent();
 
     void parameterValueChanged(int parameterIndex, float newValue) override;
     void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override { }
     void timerCallback() override;
+    void runAnalysis() override;
+    void pauseTapReads() override { analysisService->pauseClient(this); }
     void paint(juce::Graphics& g) override;
     void resized() override;
 
     void toggleAnalysisEnablement(bool enabled) {
         shouldShowFFTAnalysis = enabled;
     }
+
+    //analyzes left and right with one complex FFT instead of two real ones
+    void setPackedAnalysis(bool shouldPack) { packedAnalysis.store(shouldPack); }
+    //takes precedence over packed analysis; turning it off frees its analyzers
+    void setMultiResolutionAnalysis(bool shouldUse);
+
+    void setSpectrumSmoothing(SpectrumSmoother::Smoothing smoothing, SpectrumSmoother::Averaging averaging, float decaySeconds) {
+        leftPathProducer.setSmoothing(smoothing, averaging, decaySeconds);
+        rightPathProducer.setSmoothing(smoothing, averaging, decaySeconds);
+    }
+
+    void setSpectrogramVisible(bool shouldBeVisible) {
+        showSpectrogram = shouldBeVisible;
+        updateSpectrogramState();
+    }
 private: 
     EQAudioProcessor& audioProcessor;
     juce::Atomic<bool> parametersChanged{ false };
+    //the filter design, the analyzer and the timer are set up by the first
+    //paint(), so constructing the editor stays cheap
+    bool started = false;
+    void start();
     bool shouldShowFFTAnalysis = true;
+    //the taps and producers only hold storage while the analyzer is enabled
+    std::atomic<bool> analyzerAllocated { false };
+    void updateAnalyzerStorage();
+    void publishAnalyzerBytes();
+    std::atomic<bool> packedAnalysis { true };
+    std::atomic<bool> multiResolutionAnalysis { false };
 
     MonoChain monoChain;
     void updateChain();
     void updateResponseCurve();
-    juce::Path responseCurve;
+    Polyline responseCurve;
+    CurveRasteriser curveRasteriser;
 
     juce::Image background;
     void drawBackgroundGrid(juce::Graphics& g);
+    juce::SharedResourcePointer<GlyphCache> glyphCache;
     void drawTextLabels(juce::Graphics& g);
 
     std::vector<float> getFrequencies();
@@ -244,6 +541,15 @@ private:
     juce::Rectangle<int> getAnalysisArea();
 
     PathProducer leftPathProducer, rightPathProducer;
+
+    juce::SharedResourcePointer<AnalysisService> analysisService;
+    void updateAnalysisState();
+
+    bool showSpectrogram = false;
+    SpectrogramImage spectrogram;
+    std::vector<float> leftSpectrogramColumn, rightSpectrogramColumn;
+    //allocates the history while the spectrogram can be seen and frees it otherwise
+    void updateSpectrogramState();
 };
 
 //==============================================================================
@@ -273,6 +579,10 @@ struct AnalyzerButton : juce::ToggleButton {
 
 //==============================================================================
 
+struct SpectrogramButton : juce::ToggleButton {};
+
+//==============================================================================
+
 class EQAudioProcessorEditor  : public juce::AudioProcessorEditor
 {
 public:
@@ -280,12 +590,23 @@ public:
     ~EQAudioProcessorEditor() override;
 
     void paint (juce::Graphics&) override;
+    void paintOverChildren (juce::Graphics&) override;
     void resized() override;
+#if EQ_TRACING
+    //Ctrl+Shift+T (Cmd+Shift+T on macOS) writes the trace to getTraceFile()
+    bool keyPressed(const juce::KeyPress& key) override;
+    static juce::File getTraceFile() { return juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("EQ-trace.json"); }
+#endif
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     EQAudioProcessor& audioProcessor;
 
+    //taken before any other member is built, paintOverChildren() reports the
+    //time from here to the end of the first complete frame
+    const juce::int64 constructionStartTicks = juce::Time::getHighResolutionTicks();
+    bool firstFrameReported = false;
+
     RotarySliderWithLabels peakFreqSlider, 
         peakGainSlider, 
         peakQualitySlider, 
@@ -298,7 +619,9 @@ private:
 
     PowerButton lowcutBypassButton, peakBypassButton, highcutBypassButton;
     AnalyzerButton analyzerEnabledButton;
+    SpectrogramButton spectrogramButton;
 
+    juce::SharedResourcePointer<GlyphCache> glyphCache;
     std::vector<juce::Component*> getComponents();
 
     using APVTS = juce::AudioProcessorValueTreeState;
@@ -318,7 +641,7 @@ private:
         highcutBypassButtonAttachment,
         analyzerEnabledButtonAttachment;
 
-    LookAndFeel lnf;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EQAudioProcessorEditor)
 };
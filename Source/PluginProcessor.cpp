@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "ReferenceMatch.h"
 
 //==============================================================================
 EQAudioProcessor::EQAudioProcessor()
@@ -16,8 +17,13 @@ EQAudioProcessor::EQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                       .withOutput ("Band 1", juce::AudioChannelSet::stereo(), false)
+                       .withOutput ("Band 2", juce::AudioChannelSet::stereo(), false)
+                       .withOutput ("Band 3", juce::AudioChannelSet::stereo(), false)
+                       .withOutput ("Band 4", juce::AudioChannelSet::stereo(), false)
                      #endif
                        )
 #endif
@@ -63,7 +69,7 @@ bool EQAudioProcessor::isMidiEffect() const
 
 double EQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load();
 }
 
 int EQAudioProcessor::getNumPrograms()
@@ -96,19 +102,82 @@ void EQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
 
+    prepareOversamplers(samplesPerBlock);
+
+    //the host hears the latency of the tier it prepares us for
+    auto tier = QualityPolicy::getTier(isNonRealtime());
+    reportedLatency = getTierLatency(tier);
+    setLatencySamples(reportedLatency);
+
+    auto maxFactor = 1 << QualityPolicy::maxOversamplingOrder;
+
     juce::dsp::ProcessSpec spec;
 
-    spec.maximumBlockSize = samplesPerBlock;
+    spec.maximumBlockSize = samplesPerBlock * maxFactor;
     spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
+    spec.sampleRate = sampleRate * maxFactor;
 
     leftChain.prepare(spec);
     rightChain.prepare(spec);
 
-    updateFilters();
+    dryBuffer.setSize(2, samplesPerBlock * maxFactor);
+    topologyBuffer.setSize(2, samplesPerBlock * maxFactor);
+    fadeRamp.resize(samplesPerBlock * maxFactor);
+
+    //live and spare cut cascades trade places at every slope change, so all
+    //four sections of each get biquad coefficients and then a reset, which
+    //sizes the filters' state to them: no swap in either direction allocates
+    auto prepareCut = [&spec](CutFilter& cut) {
+        cut.prepare(spec);
+        updateCutFilter(cut, CutCoefficients(), Slope_48);
+        cut.reset();
+    };
+
+    for (auto* chain : { &leftChain, &rightChain }) {
+        prepareCut(chain->get<ChainPositions::LowCut>());
+        prepareCut(chain->get<ChainPositions::HighCut>());
+    }
+
+    for (auto* topology : { &lowCutTopology, &highCutTopology }) {
+        prepareCut(topology->left);
+        prepareCut(topology->right);
+    }
+
+    spec.maximumBlockSize = samplesPerBlock;
+    spec.numChannels = 2;
+    spec.sampleRate = sampleRate;
+
+    auto maxLatency = 0;
+    for (int t = 0; t < QualityPolicy::numTiers; ++t)
+        maxLatency = juce::jmax(maxLatency, getTierLatency((QualityTier)t));
 
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    latencyPad.setMaximumDelayInSamples(maxLatency + 1);
+    latencyPad.prepare(spec);
+
+    autoGain.prepare(sampleRate);
+    autoGainSmoother.reset(sampleRate, AutoGainCompensation::smoothingSeconds);
+    autoGainSmoother.setCurrentAndTargetValue(1.f);
+
+    activateTier(tier);
+
+    updateTailLength();
+    silentSamples = 0;
+    isSleeping = false;
+
+    loudnessMeter.prepare(sampleRate, samplesPerBlock);
+
+    if (auto* matcher = referenceMatcherForAudio.load())
+        matcher->prepare(sampleRate);
+
+    crossover.prepare(sampleRate, samplesPerBlock);
+    crossoverActive = false;
+
+    {
+        const juce::ScopedLock sl(analyzerReadersLock);
+        tapBlockSize = samplesPerBlock;
+        if (!analyzerReaders.isEmpty())
+            rebuildAnalyzerTaps(tapBlockSize);
+    }
 
     osc.initialise([](float x) { return std::sin(x); });
     spec.numChannels = getTotalNumOutputChannels();
@@ -116,6 +185,98 @@ void EQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     osc.setFrequency(1000);
 }
 
+void EQAudioProcessor::prepareOversamplers(int samplesPerBlock) {
+    for (int t = 0; t < QualityPolicy::numTiers; ++t) {
+        auto settings = qualityPolicy.getTierSettings((QualityTier)t);
+        auto& oversampler = oversamplers[(size_t)t];
+
+        if (settings.oversamplingOrder == 0) {
+            oversampler.reset();
+            continue;
+        }
+
+        auto filterType = settings.linearPhaseOversampling
+            ? juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple
+            : juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR;
+
+        oversampler = std::make_unique<juce::dsp::Oversampling<float>>(
+            2, settings.oversamplingOrder, filterType, settings.linearPhaseOversampling, true);
+        oversampler->initProcessing((size_t)samplesPerBlock);
+    }
+}
+
+int EQAudioProcessor::getTierLatency(QualityTier tier) const {
+    auto* oversampler = oversamplers[(size_t)tier].get();
+    return oversampler != nullptr ? juce::roundToInt(oversampler->getLatencyInSamples()) : 0;
+}
+
+void EQAudioProcessor::activateTier(QualityTier tier) {
+    activeTier = tier;
+    activeTierSettings = qualityPolicy.getTierSettings(tier);
+
+    //the oversampler was built at prepareToPlay, its factor wins over later edits
+    auto* oversampler = oversamplers[(size_t)tier].get();
+    auto factor = oversampler != nullptr ? (int)oversampler->getOversamplingFactor() : 1;
+    processingSampleRate = getSampleRate() * factor;
+
+    if (oversampler != nullptr)
+        oversampler->reset();
+
+    latencyPadSamples = reportedLatency - getTierLatency(tier);
+    latencyPad.reset();
+    latencyPad.setDelay((float)latencyPadSamples);
+
+    filterBackend = getFilterBackendParameter();
+    leftSvf.clear();
+    rightSvf.clear();
+
+    auto chainSettings = getChainSettings(parameterCache);
+    lowCutTopology.reset(processingSampleRate, chainSettings.lowCutSlope);
+    highCutTopology.reset(processingSampleRate, chainSettings.highCutSlope);
+    updateFilters(chainSettings);
+
+    //the filters' state belongs to the old rate; reset after the design so
+    //it is sized for the new coefficients and the first block doesn't allocate
+    leftChain.reset();
+    rightChain.reset();
+    leftSvf.reset();
+    rightSvf.reset();
+
+    //the response moves slightly with the design rate
+    autoGainStale = true;
+
+    auto activity = getStageActivity(chainSettings);
+    lowCutFader.prepare(processingSampleRate, activity.lowCut);
+    peakFader.prepare(processingSampleRate, activity.peak);
+    highCutFader.prepare(processingSampleRate, activity.highCut);
+}
+
+void EQAudioProcessor::updateQualityTier() {
+    auto tier = QualityPolicy::getTier(isNonRealtime());
+
+    //a tier with more latency than the host was told waits for the next prepareToPlay
+    if (tier != activeTier && getTierLatency(tier) <= reportedLatency)
+        activateTier(tier);
+
+    activeTierSettings.skipIdentityStages = qualityPolicy.getTierSettings(activeTier).skipIdentityStages;
+}
+
+void EQAudioProcessor::updateFilterBackend() {
+    auto backend = getFilterBackendParameter();
+    if (backend == filterBackend)
+        return;
+
+    //neither backend's state means anything to the other, so the new one
+    //starts cleared; the updateFilters() that follows designs its sections
+    filterBackend = backend;
+    leftChain.reset();
+    rightChain.reset();
+    leftSvf.clear();
+    rightSvf.clear();
+    lowCutTopology.reset(processingSampleRate, lowCutTopology.appliedSlope);
+    highCutTopology.reset(processingSampleRate, highCutTopology.appliedSlope);
+}
+
 void EQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
@@ -140,8 +301,22 @@ bool EQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+
+    //the sidechain reference is off, mono or stereo
+    for (int bus = 1; bus < layouts.inputBuses.size(); ++bus) {
+        auto set = layouts.getChannelSet(true, bus);
+        if (!set.isDisabled() && set != juce::AudioChannelSet::mono() && set != juce::AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
+    //the band buses are either off or stereo
+    for (int bus = 1; bus < layouts.outputBuses.size(); ++bus) {
+        auto set = layouts.getChannelSet(false, bus);
+        if (!set.isDisabled() && set != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
     return true;
   #endif
 }
@@ -149,39 +324,420 @@ bool EQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 
 void EQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    EQ_TRACE_THREAD_NAME("Audio");
+    EQ_TRACE_SCOPE("processBlock");
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
+    //the reference matcher hears the input before the EQ, and the sidechain
+    //before it is cleared off the channels it shares with the band outputs
+    if (auto* matcher = referenceMatcherForAudio.load()) {
+        auto sidechain = getBusCount(true) > 1 ? getBusBuffer(buffer, true, 1) : juce::AudioBuffer<float>();
+        matcher->push(juce::dsp::AudioBlock<float>(buffer).getSubsetChannelBlock(0, 2), sidechain);
+    }
+
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
     // guaranteed to be empty - they may contain garbage).
     // This is here to avoid people getting screaming feedback
     // when they first compile a plugin, but obviously you don't need to keep
     // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+    for (auto i = getMainBusNumInputChannels(); i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    updateFilters();
+    //once the filter state has decayed on silent input, a sleeping instance
+    //only checks each block for signal
+    auto inputIsSilent = isSilent(buffer);
+    if (inputIsSilent) {
+        if (isSleeping) {
+            loudnessMeter.processSilence(buffer.getNumSamples());
+            return;
+        }
 
-    juce::dsp::AudioBlock<float> block(buffer);
+        silentSamples += buffer.getNumSamples();
+    }
+    else {
+        silentSamples = 0;
+        isSleeping = false;
+    }
+
+    updateQualityTier();
+    updateFilterBackend();
+
+    auto chainSettings = getChainSettings(parameterCache);
+    updateFilters(chainSettings);
+    updateStageActivity(chainSettings);
+    updateAutoGain(chainSettings);
+    updateCrossover();
+    updateTailLength();
 
     /*buffer.clear();
 
+    juce::dsp::AudioBlock<float> block(buffer);
     juce::dsp::ProcessContextReplacing<float> stereoContex(block);
     osc.process(stereoContex);*/
 
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    auto mainBlock = juce::dsp::AudioBlock<float>(buffer).getSubsetChannelBlock(0, 2);
+    auto* oversampler = oversamplers[(size_t)activeTier].get();
+    auto processingBlock = oversampler != nullptr ? oversampler->processSamplesUp(mainBlock) : mainBlock;
+
+    //identity stages are skipped, so a flat EQ leaves the buffer untouched
+    processStage<ChainPositions::LowCut>(processingBlock, lowCutFader);
+    processStage<ChainPositions::Peak>(processingBlock, peakFader);
+    processStage<ChainPositions::HighCut>(processingBlock, highCutFader);
+
+    if (oversampler != nullptr)
+        oversampler->processSamplesDown(mainBlock);
+
+    if (latencyPadSamples > 0) {
+        juce::dsp::ProcessContextReplacing<float> padContext(mainBlock);
+        latencyPad.process(padContext);
+    }
+
+    if (autoGainSmoother.isSmoothing() || autoGainSmoother.getTargetValue() != 1.f)
+        mainBlock.multiplyBy(autoGainSmoother);
 
-    juce::dsp::ProcessContextReplacing<float> leftContex(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContex(rightBlock);
+    loudnessMeter.process(buffer);
 
-    leftChain.process(leftContex);
-    rightChain.process(rightContex);
+    if (crossoverActive)
+        processCrossover(buffer);
 
     leftChannelFifo.update(buffer);
     rightChannelFifo.update(buffer);
+
+    if (inputIsSilent && silentSamples >= tailSamples) {
+        //whatever is left in the filters is below tailDecayGain
+        leftChain.reset();
+        rightChain.reset();
+        leftSvf.reset();
+        rightSvf.reset();
+        lowCutTopology.finish();
+        highCutTopology.finish();
+        crossover.reset();
+        isSleeping = true;
+    }
+}
+
+bool EQAudioProcessor::isSilent(const juce::AudioBuffer<float>& buffer) {
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+        if (buffer.getMagnitude(channel, 0, buffer.getNumSamples()) > silenceThreshold)
+            return false;
+    }
+
+    return true;
+}
+
+//juce stores first-order sections as b0, b1, a1 and biquads as b0, b1, b2, a1, a2
+static double getDecaySamples(const Coefficients& coefficients, double decayGain) {
+    auto& c = coefficients->coefficients;
+
+    if (coefficients->getFilterOrder() == 1)
+        return getPoleDecaySamples(c[2], 0.0, decayGain);
+    if (coefficients->getFilterOrder() == 2)
+        return getPoleDecaySamples(c[3], c[4], decayGain);
+
+    return (double)coefficients->getFilterOrder();
+}
+
+static double getCutDecaySamples(const CutFilter& cut, double decayGain) {
+    //summing the sections is an upper bound for the cascade
+    double samples = 0.0;
+
+    if (!cut.isBypassed<0>())
+        samples += getDecaySamples(cut.get<0>().coefficients, decayGain);
+    if (!cut.isBypassed<1>())
+        samples += getDecaySamples(cut.get<1>().coefficients, decayGain);
+    if (!cut.isBypassed<2>())
+        samples += getDecaySamples(cut.get<2>().coefficients, decayGain);
+    if (!cut.isBypassed<3>())
+        samples += getDecaySamples(cut.get<3>().coefficients, decayGain);
+
+    return samples;
+}
+
+void EQAudioProcessor::updateTailLength() {
+    double samples = 0.0;
+
+    if (!lowCutFader.isSkipped())
+        samples += getCutDecaySamples(leftChain.get<ChainPositions::LowCut>(), tailDecayGain);
+    if (!peakFader.isSkipped())
+        samples += getDecaySamples(leftChain.get<ChainPositions::Peak>().coefficients, tailDecayGain);
+    if (!highCutFader.isSkipped())
+        samples += getCutDecaySamples(leftChain.get<ChainPositions::HighCut>(), tailDecayGain);
+
+    //the chain runs at the processing rate, the crossover and the latency at the host's
+    samples *= getSampleRate() / processingSampleRate;
+    samples += reportedLatency;
+
+    if (crossoverActive)
+        samples += crossover.getDecaySamples(tailDecayGain);
+
+    tailSamples = (int)std::ceil(samples);
+
+    auto sampleRate = getSampleRate();
+    tailLengthSeconds.store(sampleRate > 0.0 ? samples / sampleRate : 0.0);
+}
+
+template<int Position>
+void EQAudioProcessor::processStage(juce::dsp::AudioBlock<float>& block, StageFader& fader) {
+    if (fader.isSkipped())
+        return;
+
+    EQ_TRACE_SCOPE(getChainPositionName(Position));
+
+    auto numSamples = (int)block.getNumSamples();
+    auto fading = fader.isFading();
+
+    auto* topology = getTopologyFade(Position);
+    auto topologyFading = topology != nullptr && topology->isFading();
+
+    if (fading || topologyFading) {
+        if ((int)fadeRamp.size() < numSamples)
+            fadeRamp.resize(numSamples);
+    }
+
+    if (fading) {
+        dryBuffer.setSize(2, numSamples, false, false, true);
+        dryBuffer.copyFrom(0, 0, block.getChannelPointer(0), numSamples);
+        dryBuffer.copyFrom(1, 0, block.getChannelPointer(1), numSamples);
+    }
+
+    if (topologyFading) {
+        topologyBuffer.setSize(2, numSamples, false, false, true);
+        topologyBuffer.copyFrom(0, 0, block.getChannelPointer(0), numSamples);
+        topologyBuffer.copyFrom(1, 0, block.getChannelPointer(1), numSamples);
+    }
+
+    if (usesStateVariableFilters()) {
+        leftSvf.get<Position>().process(block.getChannelPointer(0), numSamples);
+        rightSvf.get<Position>().process(block.getChannelPointer(1), numSamples);
+    }
+    else {
+        auto leftBlock = block.getSingleChannelBlock(0);
+        auto rightBlock = block.getSingleChannelBlock(1);
+
+        juce::dsp::ProcessContextReplacing<float> leftContex(leftBlock);
+        juce::dsp::ProcessContextReplacing<float> rightContex(rightBlock);
+
+        leftChain.get<Position>().process(leftContex);
+        rightChain.get<Position>().process(rightContex);
+    }
+
+    if (topologyFading) {
+        //out = outgoing + ramp * (live - outgoing)
+        if (usesStateVariableFilters()) {
+            topology->svfLeft.process(topologyBuffer.getWritePointer(0), numSamples);
+            topology->svfRight.process(topologyBuffer.getWritePointer(1), numSamples);
+        }
+        else {
+            juce::dsp::AudioBlock<float> outgoingBlock(topologyBuffer);
+            auto outgoingLeft = outgoingBlock.getSingleChannelBlock(0).getSubBlock(0, (size_t)numSamples);
+            auto outgoingRight = outgoingBlock.getSingleChannelBlock(1).getSubBlock(0, (size_t)numSamples);
+
+            juce::dsp::ProcessContextReplacing<float> outgoingLeftContext(outgoingLeft);
+            juce::dsp::ProcessContextReplacing<float> outgoingRightContext(outgoingRight);
+            topology->left.process(outgoingLeftContext);
+            topology->right.process(outgoingRightContext);
+        }
+
+        topology->fillRamp(fadeRamp.data(), numSamples);
+
+        for (int channel = 0; channel < 2; ++channel) {
+            auto* live = block.getChannelPointer(channel);
+            auto* outgoing = topologyBuffer.getReadPointer(channel);
+
+            juce::FloatVectorOperations::subtract(live, outgoing, numSamples);
+            juce::FloatVectorOperations::multiply(live, fadeRamp.data(), numSamples);
+            juce::FloatVectorOperations::add(live, outgoing, numSamples);
+        }
+    }
+
+    if (fading) {
+        //out = dry + ramp * (wet - dry)
+        fader.fillRamp(fadeRamp.data(), numSamples);
+
+        for (int channel = 0; channel < 2; ++channel) {
+            auto* wet = block.getChannelPointer(channel);
+            auto* dry = dryBuffer.getReadPointer(channel);
+
+            juce::FloatVectorOperations::subtract(wet, dry, numSamples);
+            juce::FloatVectorOperations::multiply(wet, fadeRamp.data(), numSamples);
+            juce::FloatVectorOperations::add(wet, dry, numSamples);
+        }
+    }
+}
+
+StageActivity EQAudioProcessor::getStageActivity(const ChainSettings& chainSettings) const {
+    if (!activeTierSettings.skipIdentityStages)
+        return { !chainSettings.lowCutBypassed, !chainSettings.peakBypassed, !chainSettings.highCutBypassed };
+
+    return getAudibleStages(chainSettings, processingSampleRate, getIdentityTolerance());
+}
+
+template<int Position>
+void EQAudioProcessor::resetStage() {
+    leftChain.get<Position>().reset();
+    rightChain.get<Position>().reset();
+    leftSvf.get<Position>().reset();
+    rightSvf.get<Position>().reset();
+}
+
+void EQAudioProcessor::updateStageActivity(const ChainSettings& chainSettings) {
+    auto activity = getStageActivity(chainSettings);
+
+    //a stage coming back from being skipped would otherwise resume from stale state
+    if (lowCutFader.setActive(activity.lowCut)) {
+        resetStage<ChainPositions::LowCut>();
+        lowCutTopology.finish();
+    }
+    if (peakFader.setActive(activity.peak))
+        resetStage<ChainPositions::Peak>();
+    if (highCutFader.setActive(activity.highCut)) {
+        resetStage<ChainPositions::HighCut>();
+        highCutTopology.finish();
+    }
+}
+
+void EQAudioProcessor::updateAutoGain(const ChainSettings& chainSettings) {
+    if (parameterCache.get(ParameterId::AutoGain) < 0.5f) {
+        autoGainStale = true;
+        autoGainSmoother.setTargetValue(1.f);
+        return;
+    }
+
+    if (autoGainStale || chainSettings != autoGainSettings) {
+        autoGainTarget = autoGain.getCompensation(leftChain, processingSampleRate);
+        autoGainSettings = chainSettings;
+        autoGainStale = false;
+    }
+
+    autoGainSmoother.setTargetValue(autoGainTarget);
+}
+
+void EQAudioProcessor::updateCrossover() {
+    //the main bus is stereo, so any channel past it belongs to a band bus
+    auto shouldBeActive = parameterCache.get(ParameterId::CrossoverEnabled) > 0.5f
+        && getTotalNumOutputChannels() > 2;
+
+    if (shouldBeActive && !crossoverActive)
+        crossover.reset();
+
+    crossoverActive = shouldBeActive;
+
+    if (crossoverActive)
+        crossover.setSettings(getCrossoverSettings(parameterCache));
+}
+
+void EQAudioProcessor::processCrossover(juce::AudioBuffer<float>& buffer) {
+    //bands beyond numBands or on disabled buses keep the silence they were cleared to
+    Crossover::BandPointers bands {};
+    auto numBands = juce::jmin(crossover.getSettings().numBands, getBusCount(false) - 1);
+
+    for (int band = 0; band < numBands; ++band) {
+        auto bus = getBusBuffer(buffer, false, band + 1);
+        if (bus.getNumChannels() == 2)
+            bands[band] = { bus.getWritePointer(0), bus.getWritePointer(1) };
+    }
+
+    crossover.process(buffer, bands, buffer.getNumSamples());
+}
+
+void EQAudioProcessor::addAnalyzerListener(AnalyzerTapReader& reader) {
+    const juce::ScopedLock sl(analyzerReadersLock);
+    jassert(!analyzerReaders.contains(&reader));
+    analyzerReaders.add(&reader);
+
+    //before the first prepareToPlay the taps are set up there instead
+    if (analyzerReaders.size() == 1 && tapBlockSize > 0)
+        rebuildAnalyzerTaps(tapBlockSize);
+}
+
+void EQAudioProcessor::removeAnalyzerListener(AnalyzerTapReader& reader) {
+    const juce::ScopedLock sl(analyzerReadersLock);
+    jassert(analyzerReaders.contains(&reader));
+
+    //still registered, so it is paused with the others
+    if (analyzerReaders.size() == 1)
+        rebuildAnalyzerTaps(0);
+
+    analyzerReaders.removeFirstMatchingValue(&reader);
+}
+
+void EQAudioProcessor::rebuildAnalyzerTaps(int blockSize) {
+    //a pull already in progress is waited out, any later one finds the taps
+    //suspended, so the storage can change without the readers taking a lock
+    leftChannelFifo.suspend();
+    rightChannelFifo.suspend();
+
+    for (auto* reader : analyzerReaders)
+        reader->pauseTapReads();
+
+    if (blockSize > 0) {
+        leftChannelFifo.prepare(blockSize);
+        rightChannelFifo.prepare(blockSize);
+    }
+    else {
+        leftChannelFifo.release();
+        rightChannelFifo.release();
+    }
+}
+
+EQAudioProcessor::MemoryUsage EQAudioProcessor::getMemoryUsage() const {
+    MemoryUsage usage;
+
+    usage.processorBytes = sizeof(*this);
+    usage.dspBytes = getHeapBytes(dryBuffer) + fadeRamp.capacity() * sizeof(float)
+        + loudnessMeter.getAllocatedBytes() + crossover.getAllocatedBytes()
+        + (referenceMatcher != nullptr ? referenceMatcher->getAllocatedBytes() : 0);
+    usage.analyzerTapBytes = leftChannelFifo.getAllocatedBytes() + rightChannelFifo.getAllocatedBytes();
+    usage.editorAnalyzerBytes = editorAnalyzerBytes.load();
+
+    return usage;
+}
+
+ReferenceMatcher& EQAudioProcessor::getReferenceMatcher() {
+    if (referenceMatcher == nullptr) {
+        referenceMatcher = std::make_unique<ReferenceMatcher>();
+        referenceMatcher->prepare(getSampleRate() > 0.0 ? getSampleRate() : 44100.0);
+        referenceMatcherForAudio.store(referenceMatcher.get());
+    }
+
+    return *referenceMatcher;
+}
+
+void EQAudioProcessor::applyChainSettings(const ChainSettings& chainSettings) {
+    auto set = [this](ParameterId id, float value) {
+        if (auto* parameter = apvts.getParameter(getParameterID(id))) {
+            parameter->beginChangeGesture();
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            parameter->endChangeGesture();
+        }
+    };
+
+    set(ParameterId::LowCutFreq, chainSettings.lowCutFreq);
+    set(ParameterId::LowCutSlope, (float)chainSettings.lowCutSlope);
+    set(ParameterId::LowCutBypassed, chainSettings.lowCutBypassed ? 1.f : 0.f);
+    set(ParameterId::PeakFreq, chainSettings.peakFreq);
+    set(ParameterId::PeakGain, chainSettings.peakGainInDecibels);
+    set(ParameterId::PeakQuality, chainSettings.peakQuality);
+    set(ParameterId::PeakBypassed, chainSettings.peakBypassed ? 1.f : 0.f);
+    set(ParameterId::HighCutFreq, chainSettings.highCutFreq);
+    set(ParameterId::HighCutSlope, (float)chainSettings.highCutSlope);
+    set(ParameterId::HighCutBypassed, chainSettings.highCutBypassed ? 1.f : 0.f);
+}
+
+void EQAudioProcessor::setIdentityTolerance(const IdentityTolerance& tolerance) {
+    identityMaxDeviationDb.store(tolerance.maxDeviationDb);
+    identityAudibleLowHz.store(tolerance.audibleLowHz);
+    identityAudibleHighHz.store(tolerance.audibleHighHz);
+}
+
+IdentityTolerance EQAudioProcessor::getIdentityTolerance() const {
+    IdentityTolerance tolerance;
+    tolerance.maxDeviationDb = identityMaxDeviationDb.load();
+    tolerance.audibleLowHz = identityAudibleLowHz.load();
+    tolerance.audibleHighHz = identityAudibleHighHz.load();
+    return tolerance;
 }
 
 //==============================================================================
@@ -217,75 +773,176 @@ void EQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
     }
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts) {
+ChainSettings getChainSettings(const ParameterCache& parameters) {
     ChainSettings settings;
 
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainInDecibels = apvts.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope>(apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope>(apvts.getRawParameterValue("HighCut Slope")->load());
+    settings.lowCutFreq = parameters.get(ParameterId::LowCutFreq);
+    settings.highCutFreq = parameters.get(ParameterId::HighCutFreq);
+    settings.peakFreq = parameters.get(ParameterId::PeakFreq);
+    settings.peakGainInDecibels = parameters.get(ParameterId::PeakGain);
+    settings.peakQuality = parameters.get(ParameterId::PeakQuality);
+    settings.lowCutSlope = static_cast<Slope>(parameters.get(ParameterId::LowCutSlope));
+    settings.highCutSlope = static_cast<Slope>(parameters.get(ParameterId::HighCutSlope));
 
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-    settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
-    settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
+    settings.lowCutBypassed = parameters.get(ParameterId::LowCutBypassed) > 0.5f;
+    settings.peakBypassed = parameters.get(ParameterId::PeakBypassed) > 0.5f;
+    settings.highCutBypassed = parameters.get(ParameterId::HighCutBypassed) > 0.5f;
 
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate) {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-        sampleRate,
-        chainSettings.peakFreq,
-        chainSettings.peakQuality,
-        juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts) {
+    return getChainSettings(ParameterCache(apvts));
+}
+
+//EQCore can't see Parameters.h, so its copy of the defaults is checked here
+static_assert(getDefaultChainSettings().lowCutFreq == getParameterSpec(ParameterId::LowCutFreq).defaultValue
+    && getDefaultChainSettings().highCutFreq == getParameterSpec(ParameterId::HighCutFreq).defaultValue
+    && getDefaultChainSettings().peakFreq == getParameterSpec(ParameterId::PeakFreq).defaultValue
+    && getDefaultChainSettings().peakGainInDecibels == getParameterSpec(ParameterId::PeakGain).defaultValue
+    && getDefaultChainSettings().peakQuality == getParameterSpec(ParameterId::PeakQuality).defaultValue,
+    "getDefaultChainSettings() must match the parameter defaults");
+
+CrossoverSettings getCrossoverSettings(const ParameterCache& parameters) {
+    CrossoverSettings settings;
+
+    settings.numBands = 2 + (int)parameters.get(ParameterId::CrossoverBands);
+    settings.frequencies = { parameters.get(ParameterId::CrossoverLowFreq),
+        parameters.get(ParameterId::CrossoverMidFreq),
+        parameters.get(ParameterId::CrossoverHighFreq) };
+
+    //each slope step is one more Butterworth order: LR2, LR4, LR6, LR8
+    settings.butterworthOrder = 1 + (int)parameters.get(ParameterId::CrossoverSlope);
+
+    return settings;
 }
 
 void EQAudioProcessor::updatePeakFilter(const ChainSettings& chainSettings) {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    auto peakCoefficients = makePeakFilter(chainSettings, processingSampleRate);
 
     leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
     rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
 
     updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
     updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+
+    if (usesStateVariableFilters()) {
+        auto section = designPeakSvf(chainSettings.peakFreq, processingSampleRate,
+            chainSettings.peakQuality, chainSettings.peakGainInDecibels);
+        leftSvf.peak.setSections(&section, 1);
+        rightSvf.peak.setSections(&section, 1);
+    }
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements) {
-    *old = *replacements;
+void AutoGainCompensation::prepare(double sampleRate) {
+    auto kWeighting = LoudnessMeter::makeKWeighting(sampleRate);
+    auto highest = juce::jmin(20000.0, sampleRate * 0.45);
+
+    double weightSum = 0.0;
+    for (int k = 0; k < numPoints; ++k) {
+        auto frequency = juce::mapToLog10(double(k) / double(numPoints - 1), 20.0, highest);
+        auto kWeight = kWeighting[0]->getMagnitudeForFrequency(frequency, sampleRate)
+            * kWeighting[1]->getMagnitudeForFrequency(frequency, sampleRate);
+
+        frequencies[(size_t)k] = frequency;
+        weights[(size_t)k] = kWeight * kWeight;
+        weightSum += weights[(size_t)k];
+    }
+
+    for (auto& weight : weights)
+        weight /= weightSum;
 }
 
-void EQAudioProcessor::updateLowCutFilters(const ChainSettings& chainSettings) {
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
+float AutoGainCompensation::getCompensation(const MonoChain& chain, double chainSampleRate) const {
+    EQ_TRACE_SCOPE("autoGain");
+
+    double power = 0.0;
+    for (int k = 0; k < numPoints; ++k) {
+        auto magnitude = getChainMagnitude(chain, frequencies[(size_t)k], chainSampleRate);
+        power += weights[(size_t)k] * magnitude * magnitude;
+    }
+
+    if (power <= 0.0)
+        return 1.f;
+
+    //rounding alone keeps a flat EQ off unity, which would cost the gain stage
+    auto compensationDb = juce::jlimit(-maxCompensationDb, maxCompensationDb, float(-10.0 * std::log10(power)));
+    return std::abs(compensationDb) < 0.01f ? 1.f : juce::Decibels::decibelsToGain(compensationDb);
+}
+
+template<int Position>
+void EQAudioProcessor::updateCutStage(const CutCoefficients& coefficients, float frequency, Slope slope, CutTopologyFade& topology, const StageFader& fader) {
+    auto& leftCut = leftChain.get<Position>();
+    auto& rightCut = rightChain.get<Position>();
+    auto& leftSvfCut = leftSvf.get<Position>();
+    auto& rightSvfCut = rightSvf.get<Position>();
+
+    if (slope != topology.appliedSlope && !topology.isFading()) {
+        //a skipped stage is cleared before it comes back, so it can switch outright
+        if (!fader.isSkipped()) {
+            std::swap(leftCut, topology.left);
+            std::swap(rightCut, topology.right);
+            leftCut.reset();
+            rightCut.reset();
+
+            std::swap(leftSvfCut, topology.svfLeft);
+            std::swap(rightSvfCut, topology.svfRight);
+            leftSvfCut.clear();
+            rightSvfCut.clear();
+
+            topology.gain.setCurrentAndTargetValue(0.f);
+            topology.gain.setTargetValue(1.f);
+        }
+
+        topology.appliedSlope = slope;
+    }
 
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+    //the outgoing cascades keep the coefficients they had at the swap
+    updateCutFilter(leftCut, coefficients, topology.appliedSlope);
+    updateCutFilter(rightCut, coefficients, topology.appliedSlope);
+
+    if (usesStateVariableFilters()) {
+        std::array<SvfSection, 4> sections;
+        auto numSections = designButterworthSvf(frequency, processingSampleRate, 2 * (topology.appliedSlope + 1),
+            Position == ChainPositions::LowCut, sections.data());
+
+        leftSvfCut.setSections(sections.data(), numSections);
+        rightSvfCut.setSections(sections.data(), numSections);
+    }
+}
+
+void EQAudioProcessor::updateLowCutFilters(const ChainSettings& chainSettings) {
+    designLowCutFilter(chainSettings, processingSampleRate, lowCutCoefficients);
 
     leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
     rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
 
-    updateCutFilter(leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    updateCutStage<ChainPositions::LowCut>(lowCutCoefficients, chainSettings.lowCutFreq, chainSettings.lowCutSlope, lowCutTopology, lowCutFader);
 }
 
 void EQAudioProcessor::updateHighCutFilters(const ChainSettings& chainSettings) {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
+    designHighCutFilter(chainSettings, processingSampleRate, highCutCoefficients);
 
     leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
     rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
 
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    updateCutStage<ChainPositions::HighCut>(highCutCoefficients, chainSettings.highCutFreq, chainSettings.highCutSlope, highCutTopology, highCutFader);
+}
+
+CutTopologyFade* EQAudioProcessor::getTopologyFade(int position) {
+    switch (position) {
+    case ChainPositions::LowCut: return &lowCutTopology;
+    case ChainPositions::HighCut: return &highCutTopology;
+    default: return nullptr;
+    }
 }
 
 void EQAudioProcessor::updateFilters() {
-    auto chainSettings = getChainSettings(apvts);
+    updateFilters(getChainSettings(parameterCache));
+}
 
+void EQAudioProcessor::updateFilters(const ChainSettings& chainSettings) {
+    EQ_TRACE_SCOPE("updateFilters");
     updateLowCutFilters(chainSettings);
     updatePeakFilter(chainSettings);
     updateHighCutFilters(chainSettings);
@@ -296,68 +953,33 @@ void EQAudioProcessor::updateFilters() {
 juce::AudioProcessorValueTreeState::ParameterLayout EQAudioProcessor::createParameterLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
-    layout.add(std::make_unique<juce::AudioParameterFloat>(
-        "LowCut Freq",
-        "LowCut Freq", 
-        juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
-        20.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(
-        "HighCut Freq", 
-        "HighCut Freq", 
-        juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
-        20000.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(
-        "Peak Freq", 
-        "Peak Freq", 
-        juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
-        750.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(
-        "Peak Gain", 
-        "Peak Gain", 
-        juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
-        0.0f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(
-        "Peak Quality", 
-        "Peak Quality", 
-        juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
-        1.f));
-
-    juce::StringArray stringArray;
-    for (int i = 0; i < 4; ++i)
-    {
-        juce::String str;
-        str << (12 + i*12);
-        str << " db/Oct";
-        stringArray.add(str);
-    }
-
-    layout.add(std::make_unique<juce::AudioParameterChoice>(
-        "LowCut Slope",
-        "LowCut Slope",
-        stringArray,
-        0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>(
-        "HighCut Slope",
-        "HighCut Slope",
-        stringArray,
-        0));
-
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        "LowCut Bypassed",
-        "LowCut Bypassed",
-        false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        "Peak Bypassed",
-        "Peak Bypassed",
-        false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        "HighCut Bypassed",
-        "HighCut Bypassed",
-        false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        "Analyzer Enabled",
-        "Analyzer Enabled",
-        true));
+
+    for (auto& spec : parameterSpecs) {
+        switch (spec.kind) {
+        case ParameterKind::Float:
+            layout.add(std::make_unique<juce::AudioParameterFloat>(
+                spec.id,
+                spec.id,
+                juce::NormalisableRange<float>(spec.minimum, spec.maximum, spec.interval, spec.skew),
+                spec.defaultValue));
+            break;
+        case ParameterKind::Choice:
+            layout.add(std::make_unique<juce::AudioParameterChoice>(
+                spec.id,
+                spec.id,
+                juce::StringArray(spec.choices, spec.numChoices),
+                (int)spec.defaultValue));
+            break;
+        case ParameterKind::Bool:
+            layout.add(std::make_unique<juce::AudioParameterBool>(
+                spec.id,
+                spec.id,
+                spec.defaultValue > 0.5f));
+            break;
+        default:
+            break;
+        }
+    }
 
     return layout;
 }
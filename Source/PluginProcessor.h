@@ -10,67 +10,29 @@
 
 #include <JuceHeader.h>
 #include <array>
+#include "Crossover.h"
+#include "EQCore.h"
+#include "Fifo.h"
+#include "LoudnessMeter.h"
+#include "Parameters.h"
+#include "QualityPolicy.h"
+#include "Trace.h"
 
-template<typename T>
-struct Fifo {
-    void prepare(int numChannels, int numSamples) {
-        static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,  
-            "prepare(numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
-        for (auto& buffer : buffers) {
-            buffer.setSize(numChannels,
-                numSamples,
-                false,
-                true,
-                true);
-            buffer.clear();
-        }
-    }
-
-    void prepare(size_t numElements) {
-        static_assert(std::is_same_v<T, std::vector<float>>,
-            "prepare(numElements) should only be used when the Fifo is holding std::vector<float>");
-        for (auto& buffer : buffers) {
-            buffer.clear();
-            buffer.resize(numElements, 0);
-        }
-    }
-
-    bool push(const T& t) {
-        auto write = fifo.write(1);
-
-        if (write.blockSize1 > 0) {
-            buffers[write.startIndex1] = t;
-            return true;
-        }
-
-        return false;
-    }
-
-    bool pull(T& t) {
-        auto read = fifo.read(1);
-
-        if (read.blockSize1 > 0) {
-            t = buffers[read.startIndex1];
-            return true;
-        }
-
-        return false;
-    }
-
-    int getNumAvailableForReading() const {
-        return fifo.getNumReady();
-    }
-private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo{ Capacity };
-};
+struct ReferenceMatcher;
 
 enum Channel {
     Right, // 0
     Left // 1
 };
 
+/*  Audio-thread tap feeding the analyzer. It holds no storage until prepare()
+    and none again after release(), and update() returns straight away while
+    it is released, so an instance nobody is looking at costs nothing.
+    The storage only changes in prepare() and release(), which are preceded by
+    suspend() and by pausing every reader (see AnalyzerTapReader), so the
+    reader pulls from the lock-free Fifo without a lock. The audio thread
+    tries tapLock, which nothing else takes while the tap is running: it only
+    skips the blocks that arrive while the storage is being replaced. */
 template<typename BlockType>
 struct SingleChannelSampleFifo {
     SingleChannelSampleFifo(Channel ch) : channelToUse(ch) {
@@ -78,7 +40,14 @@ struct SingleChannelSampleFifo {
     }
 
     void update(const BlockType& buffer) {
-        jassert(prepared.get());
+        if (!prepared.get())
+            return;
+
+        EQ_TRACE_SCOPE("SingleChannelSampleFifo::update");
+        const juce::SpinLock::ScopedTryLockType lock(tapLock);
+        if (!lock.isLocked() || !prepared.get())
+            return;
+
         jassert(buffer.getNumChannels() > channelToUse);
         auto* channelPtr = buffer.getReadPointer(channelToUse);
 
@@ -87,7 +56,15 @@ struct SingleChannelSampleFifo {
         }
     }
 
+    //stops update() and getAudioBuffer() until the next prepare()
+    void suspend() {
+        const juce::SpinLock::ScopedLockType lock(tapLock);
+        prepared.set(false);
+    }
+
+    //the reader must be paused
     void prepare(int bufferSize) {
+        const juce::SpinLock::ScopedLockType lock(tapLock);
         prepared.set(false);
         size.set(bufferSize);
         bufferToFill.setSize(1, //channel
@@ -95,16 +72,41 @@ struct SingleChannelSampleFifo {
             false, //keepExistingContent
             true, //clear extra space
             true); //avoid reallocation
+        audioBufferFifo.release();
         audioBufferFifo.prepare(1, bufferSize);
         fifoIndex = 0;
+        allocatedBytes.store(getHeapBytes(bufferToFill) + audioBufferFifo.getAllocatedBytes());
         prepared.set(true);
     }
 
+    //the reader must be paused
+    void release() {
+        const juce::SpinLock::ScopedLockType lock(tapLock);
+        prepared.set(false);
+        bufferToFill = BlockType();
+        audioBufferFifo.release();
+        fifoIndex = 0;
+        allocatedBytes.store(0);
+    }
+
+    size_t getAllocatedBytes() const { return allocatedBytes.load(); }
+
     int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
 
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
+    //reader: 'buf' is swapped in when it has the fifo's shape, the audio thread writes into it next
+    bool getAudioBuffer(BlockType& buf) {
+        if (!prepared.get())
+            return false;
+
+        if (buf.getNumChannels() == 1 && buf.getNumSamples() == size.get())
+            return audioBufferFifo.pullSwap(buf);
+
+        return audioBufferFifo.pull(buf);
+    }
+
+    int getNumDroppedBuffers() const { return audioBufferFifo.getNumDroppedPushes(); }
 private:
     Channel channelToUse;
     int fifoIndex = 0;
@@ -112,12 +114,13 @@ private:
     BlockType bufferToFill;
     juce::Atomic<bool> prepared = false;
     juce::Atomic<int> size = 0;
+    std::atomic<size_t> allocatedBytes { 0 };
+    juce::SpinLock tapLock;
 
     void pushNextSampleIntoFifo(float sample) {
         if (fifoIndex == bufferToFill.getNumSamples()) {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
+            //a dropped push keeps the buffer, which is simply refilled
+            audioBufferFifo.pushSwap(bufferToFill);
 
             fifoIndex = 0;
         }
@@ -126,80 +129,112 @@ private:
     }
 };
 
-enum Slope {
-    Slope_12,
-    Slope_24,
-    Slope_36,
-    Slope_48
+/*  Whatever pulls from the analyzer taps, registered with
+    EQAudioProcessor::addAnalyzerListener(). */
+struct AnalyzerTapReader {
+    virtual ~AnalyzerTapReader() = default;
+    //blocks until no pull is in progress; pulls may start again straight
+    //away, and find the taps suspended until they are rebuilt
+    virtual void pauseTapReads() = 0;
 };
 
-struct ChainSettings {
-    float peakFreq { 0 }, peakGainInDecibels { 0 }, peakQuality { 1.f };
-    float lowCutFreq { 0 }, highCutFreq { 0 };
-    Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
+ChainSettings getChainSettings(const ParameterCache& parameters);
+//resolves every ID by string, prefer the ParameterCache overload on hot paths
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-    bool lowCutBypassed{ false }, peakBypassed{ false }, highCutBypassed{ false };
+//the split points as the parameters give them; the crossover sorts and clamps them
+CrossoverSettings getCrossoverSettings(const ParameterCache& parameters);
 
-};
+//fades a stage in or out of the signal path so identity stages can be
+//dropped from the hot path without clicks
+struct StageFader {
+    void prepare(double sampleRate, bool shouldBeActive) {
+        gain.reset(sampleRate, fadeSeconds);
+        gain.setCurrentAndTargetValue(shouldBeActive ? 1.f : 0.f);
+    }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
+    //returns true when a skipped stage comes back and its state must be cleared
+    bool setActive(bool shouldBeActive) {
+        auto target = shouldBeActive ? 1.f : 0.f;
+        if (gain.getTargetValue() == target)
+            return false;
+
+        auto wasSkipped = isSkipped();
+        gain.setTargetValue(target);
+        return shouldBeActive && wasSkipped;
+    }
+
+    bool isSkipped() const { return !gain.isSmoothing() && gain.getTargetValue() == 0.f; }
+    bool isFading() const { return gain.isSmoothing(); }
 
-using Filter = juce::dsp::IIR::Filter<float>;
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+    void fillRamp(float* ramp, int numSamples) {
+        for (int i = 0; i < numSamples; ++i)
+            ramp[i] = gain.getNextValue();
+    }
 
-enum ChainPositions {
-    LowCut,
-    Peak,
-    HighCut
+    static constexpr double fadeSeconds = 0.01;
+private:
+    juce::LinearSmoothedValue<float> gain;
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
-
-template<int Index, typename ChainType, typename CoefficientType>
-void update(ChainType& chain, const CoefficientType& coefficients) {
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
-}
-
-template <typename ChainType, typename CoefficientType>
-void updateCutFilter(ChainType& chain, const CoefficientType& coefficients, const Slope& slope) {
-
-    chain.template setBypassed<0>(true);
-    chain.template setBypassed<1>(true);
-    chain.template setBypassed<2>(true);
-    chain.template setBypassed<3>(true);
-
-    switch (slope) {
-    case Slope_48:
-        update<3>(chain, coefficients);
-    case Slope_36:
-        update<2>(chain, coefficients);
-    case Slope_24:
-        update<1>(chain, coefficients);
-    case Slope_12:
-        update<0>(chain, coefficients);
-        break;
-    default:
-        break;
+/*  Crossfades a cut stage from its old cascade to a new one when the slope
+    changes. Sections joining the cascade would otherwise start mid-stream
+    from cleared state, and the ones already running would jump to the new
+    order's Qs. At the change the live cascades are swapped (moved, so
+    nothing allocates) into left/right, where they keep running on their
+    old topology while fading out; the live ones restart from cleared state
+    with the new topology and fade in. Outside the window left/right are
+    never processed, so the steady-state cost is unchanged. The SVF backend
+    keeps its outgoing cascades in svfLeft/svfRight the same way. */
+struct CutTopologyFade {
+    void reset(double sampleRate, Slope slope) {
+        gain.reset(sampleRate, fadeSeconds);
+        gain.setCurrentAndTargetValue(1.f);
+        appliedSlope = slope;
+        left.reset();
+        right.reset();
+        svfLeft.clear();
+        svfRight.clear();
     }
-}
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate) {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(
-        chainSettings.lowCutFreq,
-        sampleRate,
-        2 * (chainSettings.lowCutSlope + 1));
-}
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate) {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(
-        chainSettings.highCutFreq,
-        sampleRate,
-        2 * (chainSettings.highCutSlope + 1));
-}
+    //the live cascade's share of the output, rising from 0 to 1 during a fade
+    bool isFading() const { return gain.isSmoothing(); }
+    void finish() { gain.setCurrentAndTargetValue(1.f); }
+
+    void fillRamp(float* ramp, int numSamples) {
+        for (int i = 0; i < numSamples; ++i)
+            ramp[i] = gain.getNextValue();
+    }
 
+    static constexpr double fadeSeconds = 0.02;
+
+    CutFilter left, right;
+    SvfCut svfLeft, svfRight;
+    juce::LinearSmoothedValue<float> gain;
+    //what the live cascades run; a change arriving mid-fade waits for the fade to end
+    Slope appliedSlope = Slope_12;
+};
+
+/*  Level compensation taken from the EQ's own response instead of measured
+    at its output, so it adds no latency and costs nothing per sample beyond
+    a gain. The programme is modelled as pink noise (equal power per octave,
+    so evenly weighted on a log grid) heard through BS.1770 K-weighting, and
+    the compensation gives that signal the same power after the EQ as
+    before it. */
+struct AutoGainCompensation {
+    //sets up the grid and weights for output at 'sampleRate', allocates
+    void prepare(double sampleRate);
+
+    //linear gain for 'chain' as designed at 'chainSampleRate'; a few hundred
+    //magnitude evaluations, so only worth calling when the settings change
+    float getCompensation(const MonoChain& chain, double chainSampleRate) const;
+
+    static constexpr int numPoints = 64;
+    static constexpr float maxCompensationDb = 24.f;
+    static constexpr double smoothingSeconds = 0.05;
+private:
+    std::array<double, numPoints> frequencies {}, weights {};
+};
 
 
 //==============================================================================
@@ -245,6 +280,9 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    void setIdentityTolerance(const IdentityTolerance& tolerance);
+    IdentityTolerance getIdentityTolerance() const;
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {
         *this, 
@@ -252,18 +290,148 @@ public:
         "Parameters", 
         createParameterLayout()};
 
+    //resolved once from apvts, read by the audio thread and the editor
+    const ParameterCache parameterCache { apvts };
+
     using BlockType = juce::AudioBuffer<float>;
     SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
     SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
 
+    //metered right after the filter chain, readable without an editor
+    LoudnessMeter loudnessMeter;
+
+    //realtime and offline tier settings, picked from isNonRealtime()
+    QualityPolicy qualityPolicy;
+
+    //message thread: the analyzer taps only hold storage, and are only fed,
+    //while at least one editor shows the analyzer
+    void addAnalyzerListener(AnalyzerTapReader& reader);
+    void removeAnalyzerListener(AnalyzerTapReader& reader);
+
+    //per-instance heap use, for sizing large sessions. JUCE-internal storage
+    //(oversampler filters, IIR state, parameter objects) isn't included
+    struct MemoryUsage {
+        size_t processorBytes = 0, dspBytes = 0, analyzerTapBytes = 0, editorAnalyzerBytes = 0;
+
+        size_t getTotalBytes() const { return processorBytes + dspBytes + analyzerTapBytes + editorAnalyzerBytes; }
+    };
+
+    //message thread
+    MemoryUsage getMemoryUsage() const;
+    //the open editor reports what its analyzer holds
+    void setEditorAnalyzerBytes(size_t bytes) { editorAnalyzerBytes.store(bytes); }
+
+    //time from the start of the last editor's construction to the end of its
+    //first painted frame, in milliseconds, 0 until an editor has painted
+    void setEditorFirstFrameTime(double milliseconds) { editorFirstFrameMs.store(milliseconds); }
+    double getEditorFirstFrameTime() const { return editorFirstFrameMs.load(); }
+
+    //message thread: created on first use and kept until the processor goes,
+    //so the audio thread never sees it deleted
+    ReferenceMatcher& getReferenceMatcher();
+    //sets the EQ parameters as one host-visible gesture each, e.g. from a fit
+    void applyChainSettings(const ChainSettings& chainSettings);
+
 private:
+    //the biquads are designed in either backend: the tail length and auto
+    //gain read their coefficients, and the responses are the same
     MonoChain leftChain, rightChain;
+    SvfChain leftSvf, rightSvf;
+
+    //the Filter Backend parameter, followed at the start of each block
+    FilterBackend filterBackend = FilterBackend::Biquad;
+    FilterBackend getFilterBackendParameter() const { return (FilterBackend)(int)parameterCache.get(ParameterId::FilterBackend); }
+    void updateFilterBackend();
+    bool usesStateVariableFilters() const { return filterBackend == FilterBackend::StateVariable; }
 
     void updatePeakFilter (const ChainSettings& chainSettings);
 
+    CutCoefficients lowCutCoefficients, highCutCoefficients;
+
     void updateLowCutFilters(const ChainSettings& chainSettings);
     void updateHighCutFilters(const ChainSettings& chainSettings);
     void updateFilters();
+    void updateFilters(const ChainSettings& chainSettings);
+
+    std::atomic<float> identityMaxDeviationDb { IdentityTolerance().maxDeviationDb },
+        identityAudibleLowHz { IdentityTolerance().audibleLowHz },
+        identityAudibleHighHz { IdentityTolerance().audibleHighHz };
+
+    StageFader lowCutFader, peakFader, highCutFader;
+    juce::AudioBuffer<float> dryBuffer;
+    std::vector<float> fadeRamp;
+
+    CutTopologyFade lowCutTopology, highCutTopology;
+    //the stage's input, run through the outgoing cascade during a topology fade
+    juce::AudioBuffer<float> topologyBuffer;
+
+    template<int Position>
+    void updateCutStage(const CutCoefficients& coefficients, float frequency, Slope slope, CutTopologyFade& topology, const StageFader& fader);
+    CutTopologyFade* getTopologyFade(int position);
+
+    void updateStageActivity(const ChainSettings& chainSettings);
+
+    template<int Position>
+    void processStage(juce::dsp::AudioBlock<float>& block, StageFader& fader);
+    template<int Position>
+    void resetStage();
+
+    StageActivity getStageActivity(const ChainSettings& chainSettings) const;
+
+    AutoGainCompensation autoGain;
+    juce::LinearSmoothedValue<float> autoGainSmoother;
+    //the settings the current compensation was computed for
+    ChainSettings autoGainSettings;
+    float autoGainTarget = 1.f;
+    bool autoGainStale = true;
+
+    void updateAutoGain(const ChainSettings& chainSettings);
+
+    //one oversampler per tier, null where the tier runs at the host rate
+    std::array<std::unique_ptr<juce::dsp::Oversampling<float>>, QualityPolicy::numTiers> oversamplers;
+    QualityTier activeTier = QualityTier::Realtime;
+    QualityTierSettings activeTierSettings;
+    double processingSampleRate = 44100.0;
+
+    //the latency told to the host at prepareToPlay; a lower-latency tier is
+    //padded up to it so the report holds when the tier changes between blocks
+    int reportedLatency = 0, latencyPadSamples = 0;
+    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::None> latencyPad;
+
+    void prepareOversamplers(int samplesPerBlock);
+    int getTierLatency(QualityTier tier) const;
+    void activateTier(QualityTier tier);
+    void updateQualityTier();
+
+    //the tail is where the slowest poles have decayed by tailDecayGain (-100 dB)
+    static constexpr double tailDecayGain = 1.0e-5;
+    static constexpr float silenceThreshold = 1.0e-6f;
+
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    int tailSamples = 0, silentSamples = 0;
+    bool isSleeping = false;
+
+    //splits the EQ's output onto the band buses; idle unless one of them is enabled
+    Crossover crossover;
+    bool crossoverActive = false;
+
+    void updateCrossover();
+    void processCrossover(juce::AudioBuffer<float>& buffer);
+
+    void updateTailLength();
+    static bool isSilent(const juce::AudioBuffer<float>& buffer);
+
+    //a block size of 0 releases the taps. Called with analyzerReadersLock held
+    void rebuildAnalyzerTaps(int blockSize);
+
+    juce::CriticalSection analyzerReadersLock;
+    juce::Array<AnalyzerTapReader*> analyzerReaders;
+    int tapBlockSize = 0;
+    std::atomic<size_t> editorAnalyzerBytes { 0 };
+    std::atomic<double> editorFirstFrameMs { 0.0 };
+
+    std::unique_ptr<ReferenceMatcher> referenceMatcher;
+    std::atomic<ReferenceMatcher*> referenceMatcherForAudio { nullptr };
 
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    QualityPolicy.h
+    Per-tier processing settings: a lean tier for realtime playback and a
+    high-quality one for offline bounces, picked from isNonRealtime().
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+enum class QualityTier {
+    Realtime,
+    Offline,
+
+    NumTiers
+};
+
+struct QualityTierSettings {
+    //the EQ runs at 2^oversamplingOrder times the host rate, 0 turns oversampling off
+    int oversamplingOrder { 0 };
+    //linear-phase equiripple FIR half-bands at their longest instead of the
+    //cheap polyphase IIR ones
+    bool linearPhaseOversampling { false };
+    //drop stages inside the identity tolerance from the signal path
+    bool skipIdentityStages { true };
+
+    int getOversamplingFactor() const { return 1 << oversamplingOrder; }
+};
+
+/*  Oversampling removes the bilinear cramping of the peak and the cuts near
+    nyquist. Its settings take effect at the next prepareToPlay(), which is
+    where the oversamplers are allocated, and skipIdentityStages is read
+    every block. Both tiers are prepared
+    together so a host that flips isNonRealtime() between blocks can be
+    followed without allocating. */
+struct QualityPolicy {
+    static constexpr int maxOversamplingOrder = 2;
+    static constexpr int numTiers = (int)QualityTier::NumTiers;
+
+    QualityPolicy() {
+        QualityTierSettings offline;
+        offline.oversamplingOrder = 1;
+        offline.linearPhaseOversampling = true;
+        offline.skipIdentityStages = false;
+
+        setTierSettings(QualityTier::Realtime, QualityTierSettings());
+        setTierSettings(QualityTier::Offline, offline);
+    }
+
+    void setTierSettings(QualityTier tier, const QualityTierSettings& settings) {
+        auto& stored = tiers[(size_t)tier];
+        stored.oversamplingOrder.store(juce::jlimit(0, maxOversamplingOrder, settings.oversamplingOrder));
+        stored.linearPhaseOversampling.store(settings.linearPhaseOversampling);
+        stored.skipIdentityStages.store(settings.skipIdentityStages);
+    }
+
+    QualityTierSettings getTierSettings(QualityTier tier) const {
+        auto& stored = tiers[(size_t)tier];
+
+        QualityTierSettings settings;
+        settings.oversamplingOrder = stored.oversamplingOrder.load();
+        settings.linearPhaseOversampling = stored.linearPhaseOversampling.load();
+        settings.skipIdentityStages = stored.skipIdentityStages.load();
+        return settings;
+    }
+
+    static QualityTier getTier(bool isNonRealtime) {
+        return isNonRealtime ? QualityTier::Offline : QualityTier::Realtime;
+    }
+private:
+    struct StoredSettings {
+        std::atomic<int> oversamplingOrder { 0 };
+        std::atomic<bool> linearPhaseOversampling { false }, skipIdentityStages { true };
+    };
+
+    std::array<StoredSettings, numTiers> tiers;
+};
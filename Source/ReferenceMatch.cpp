@@ -0,0 +1,585 @@
+/*
+  ==============================================================================
+
+    ReferenceMatch.cpp
+    Long-term spectra of the input and a sidechain reference, and a fit of
+    the EQ's settings to the difference between them.
+
+  ==============================================================================
+*/
+
+#include "ReferenceMatch.h"
+#include <algorithm>
+#include <numeric>
+
+void LongTermSpectrum::prepare(juce::dsp::FFT& fft, juce::dsp::WindowingFunction<float>& newWindow) {
+    forwardFFT = &fft;
+    window = &newWindow;
+
+    history.assign(fftSize, 0.f);
+    fftData.assign(fftSize * 2, 0.f);
+    powerSums.assign(numBins, 0.0);
+    reset();
+}
+
+void LongTermSpectrum::release() {
+    history = {};
+    fftData = {};
+    powerSums = {};
+    writeIndex = samplesSinceFrame = numFrames = 0;
+}
+
+void LongTermSpectrum::reset() {
+    std::fill(history.begin(), history.end(), 0.f);
+    std::fill(powerSums.begin(), powerSums.end(), 0.0);
+    writeIndex = samplesSinceFrame = numFrames = 0;
+}
+
+void LongTermSpectrum::push(const float* samples, int numSamples) {
+    if (history.empty())
+        return;
+
+    for (int i = 0; i < numSamples; ++i) {
+        history[(size_t)writeIndex] = samples[i];
+        writeIndex = (writeIndex + 1) % fftSize;
+
+        if (++samplesSinceFrame == hopSize) {
+            samplesSinceFrame = 0;
+            analyzeFrame();
+        }
+    }
+}
+
+void LongTermSpectrum::analyzeFrame() {
+    //oldest sample first
+    auto tail = fftSize - writeIndex;
+    std::copy(history.begin() + writeIndex, history.end(), fftData.begin());
+    std::copy(history.begin(), history.begin() + writeIndex, fftData.begin() + tail);
+    std::fill(fftData.begin() + fftSize, fftData.end(), 0.f);
+
+    auto range = juce::FloatVectorOperations::findMinAndMax(fftData.data(), fftSize);
+    if (range.getStart() == 0.f && range.getEnd() == 0.f)
+        return;
+
+    window->multiplyWithWindowingTable(fftData.data(), fftSize);
+    forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());
+
+    for (int bin = 0; bin < numBins; ++bin)
+        powerSums[(size_t)bin] += double(fftData[(size_t)bin]) * double(fftData[(size_t)bin]);
+
+    ++numFrames;
+}
+
+//==============================================================================
+
+ReferenceMatcher::ReferenceMatcher() {
+    analysisService->addClient(this);
+}
+
+ReferenceMatcher::~ReferenceMatcher() {
+    analysisService->removeClient(this);
+}
+
+void ReferenceMatcher::prepare(double newSampleRate) {
+    //bins no longer line up with what has been averaged so far
+    if (newSampleRate != sampleRate.load())
+        resetRequested.store(true);
+
+    sampleRate.store(newSampleRate);
+}
+
+void ReferenceMatcher::push(const juce::dsp::AudioBlock<float>& main, const juce::AudioBuffer<float>& sidechain) {
+    if (!capturing.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(captureLock);
+    if (!lock.isLocked() || !capturing.load())
+        return;
+
+    auto numSamples = (int)main.getNumSamples();
+    auto numMainChannels = (int)main.getNumChannels();
+    auto numReferenceChannels = sidechain.getNumSamples() >= numSamples ? sidechain.getNumChannels() : 0;
+
+    int start1, size1, start2, size2;
+    ring.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    auto written = size1 + size2;
+    if (written < numSamples)
+        droppedSamples.fetch_add(numSamples - written, std::memory_order_relaxed);
+
+    auto writeSpan = [&](int ringStart, int size, int sourceStart) {
+        for (int i = 0; i < size; ++i) {
+            float mainSum = 0.f, referenceSum = 0.f;
+
+            for (int channel = 0; channel < numMainChannels; ++channel)
+                mainSum += main.getSample(channel, sourceStart + i);
+            for (int channel = 0; channel < numReferenceChannels; ++channel)
+                referenceSum += sidechain.getSample(channel, sourceStart + i);
+
+            mainRing[(size_t)(ringStart + i)] = numMainChannels > 0 ? mainSum / numMainChannels : 0.f;
+            referenceRing[(size_t)(ringStart + i)] = numReferenceChannels > 0 ? referenceSum / numReferenceChannels : 0.f;
+        }
+    };
+
+    writeSpan(start1, size1, 0);
+    writeSpan(start2, size2, size1);
+    ring.finishedWrite(written);
+}
+
+void ReferenceMatcher::startCapture() {
+    analysisService->pauseClient(this);
+
+    {
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+
+        mainRing.assign(ringSize, 0.f);
+        referenceRing.assign(ringSize, 0.f);
+        ring.reset();
+
+        auto& fft = analysisService->getFFT(LongTermSpectrum::fftOrder);
+        auto& window = analysisService->getWindow(LongTermSpectrum::fftSize);
+        mainSpectrum.prepare(fft, window);
+        referenceSpectrum.prepare(fft, window);
+
+        numFrames.store(0);
+        droppedSamples.store(0);
+        resetRequested.store(false);
+        capturing.store(true);
+    }
+
+    updateVisibility();
+}
+
+void ReferenceMatcher::stopCapture() {
+    {
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+        capturing.store(false);
+    }
+
+    analysisService->pauseClient(this);
+
+    //the estimates stay for fitting, only the transfer ring goes
+    mainRing = {};
+    referenceRing = {};
+    ring.reset();
+
+    updateVisibility();
+}
+
+void ReferenceMatcher::requestFit() {
+    fitRequested.store(true);
+    updateVisibility();
+}
+
+bool ReferenceMatcher::getFitResult(ReferenceMatchResult& result) {
+    {
+        const juce::SpinLock::ScopedLockType lock(resultLock);
+        if (!hasNewResult)
+            return false;
+
+        result = latestResult;
+        hasNewResult = false;
+    }
+
+    updateVisibility();
+    return true;
+}
+
+void ReferenceMatcher::updateVisibility() {
+    setAnalysisState(capturing.load() || fitRequested.load(), AnalysisService::Priority::Background);
+}
+
+size_t ReferenceMatcher::getAllocatedBytes() const {
+    return (mainRing.capacity() + referenceRing.capacity()) * sizeof(float)
+        + mainSpectrum.getAllocatedBytes() + referenceSpectrum.getAllocatedBytes();
+}
+
+void ReferenceMatcher::runAnalysis() {
+    if (resetRequested.exchange(false)) {
+        mainSpectrum.reset();
+        referenceSpectrum.reset();
+    }
+
+    if (!mainRing.empty()) {
+        int start1, size1, start2, size2;
+        ring.prepareToRead(ring.getNumReady(), start1, size1, start2, size2);
+
+        mainSpectrum.push(mainRing.data() + start1, size1);
+        referenceSpectrum.push(referenceRing.data() + start1, size1);
+        mainSpectrum.push(mainRing.data() + start2, size2);
+        referenceSpectrum.push(referenceRing.data() + start2, size2);
+
+        ring.finishedRead(size1 + size2);
+        numFrames.store(juce::jmin(mainSpectrum.getNumFrames(), referenceSpectrum.getNumFrames()));
+    }
+
+    if (fitRequested.exchange(false)) {
+        auto result = fit();
+
+        const juce::SpinLock::ScopedLockType lock(resultLock);
+        latestResult = result;
+        hasNewResult = true;
+    }
+}
+
+//==============================================================================
+
+namespace {
+
+//the difference curve on a log grid, and the error of a candidate EQ against it
+struct MatchModel {
+    static constexpr int numPoints = 96;
+
+    MatchModel(const LongTermSpectrum& main, const LongTermSpectrum& reference, double newSampleRate) :
+        sampleRate(newSampleRate)
+    {
+        auto binWidth = sampleRate / LongTermSpectrum::fftSize;
+        auto highest = juce::jmin(16000.0, sampleRate * 0.45);
+        auto halfBand = std::pow(2.0, 1.0 / 12.0);
+
+        double loudest = 0.0;
+        for (int bin = 1; bin < LongTermSpectrum::numBins; ++bin)
+            loudest = juce::jmax(loudest, main.getPower(bin), reference.getPower(bin));
+
+        //points where either signal is more than 80 dB below its loudest bin say nothing
+        auto floor = loudest * 1.0e-8;
+
+        for (int k = 0; k < numPoints; ++k) {
+            auto frequency = juce::mapToLog10(double(k) / double(numPoints - 1), 25.0, highest);
+
+            //1/6 octave around the point, at least the nearest bin
+            auto lowBin = juce::jlimit(1, LongTermSpectrum::numBins - 1, (int)std::ceil(frequency / halfBand / binWidth));
+            auto highBin = juce::jlimit(lowBin, LongTermSpectrum::numBins - 1, (int)std::floor(frequency * halfBand / binWidth));
+
+            double mainPower = 0.0, referencePower = 0.0;
+            for (int bin = lowBin; bin <= highBin; ++bin) {
+                mainPower += main.getPower(bin);
+                referencePower += reference.getPower(bin);
+            }
+
+            auto valid = mainPower > floor && referencePower > floor;
+
+            frequencies[k] = frequency;
+            weights[k] = valid ? 1.0 : 0.0;
+            targetDb[k] = valid ? 10.0 * std::log10(referencePower / mainPower) : 0.0;
+        }
+    }
+
+    bool hasData() const {
+        return std::any_of(std::begin(weights), std::end(weights), [](double w) { return w > 0.0; });
+    }
+
+    //mean square error with the best broadband offset removed; 'offset' is that offset
+    double getError(const ChainSettings& settings, double* offset = nullptr) {
+        ++numEvaluations;
+        updateMonoChain(chain, settings, sampleRate);
+
+        double difference[numPoints];
+        double weightSum = 0.0, mean = 0.0;
+        for (int k = 0; k < numPoints; ++k) {
+            auto modelDb = juce::Decibels::gainToDecibels(getChainMagnitude(chain, frequencies[k], sampleRate), -200.0);
+            difference[k] = modelDb - targetDb[k];
+            weightSum += weights[k];
+            mean += weights[k] * difference[k];
+        }
+
+        if (weightSum <= 0.0)
+            return 0.0;
+
+        mean /= weightSum;
+        if (offset != nullptr)
+            *offset = -mean;
+
+        double error = 0.0;
+        for (int k = 0; k < numPoints; ++k)
+            error += weights[k] * (difference[k] - mean) * (difference[k] - mean);
+
+        return error / weightSum;
+    }
+
+    double sampleRate;
+    double frequencies[numPoints], weights[numPoints], targetDb[numPoints];
+    MonoChain chain;
+    int numEvaluations = 0;
+};
+
+//bounded Nelder-Mead over the unit cube, 'x' holds the start and receives the best point
+template<typename Function>
+double minimise(Function&& function, std::vector<double>& x, double step, int maxEvaluations) {
+    auto n = x.size();
+    auto clamp = [](std::vector<double>& p) {
+        for (auto& v : p)
+            v = juce::jlimit(0.0, 1.0, v);
+    };
+
+    std::vector<std::vector<double>> simplex(n + 1, x);
+    std::vector<double> values(n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        simplex[i + 1][i] += simplex[i + 1][i] + step <= 1.0 ? step : -step;
+        clamp(simplex[i + 1]);
+    }
+
+    for (size_t i = 0; i <= n; ++i)
+        values[i] = function(simplex[i]);
+
+    auto evaluations = (int)n + 1;
+    std::vector<double> centroid(n), trial(n), second(n);
+
+    while (evaluations < maxEvaluations) {
+        std::vector<size_t> order(n + 1);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return values[a] < values[b]; });
+
+        auto best = order.front(), worst = order.back(), nextWorst = order[n - 1];
+        if (values[worst] - values[best] < 1.0e-6)
+            break;
+
+        std::fill(centroid.begin(), centroid.end(), 0.0);
+        for (size_t i = 0; i <= n; ++i) {
+            if (i == worst)
+                continue;
+            for (size_t d = 0; d < n; ++d)
+                centroid[d] += simplex[i][d] / double(n);
+        }
+
+        auto pointAlong = [&](std::vector<double>& p, double t) {
+            for (size_t d = 0; d < n; ++d)
+                p[d] = centroid[d] + t * (simplex[worst][d] - centroid[d]);
+            clamp(p);
+        };
+
+        pointAlong(trial, -1.0);
+        auto reflected = function(trial);
+        ++evaluations;
+
+        if (reflected < values[best]) {
+            pointAlong(second, -2.0);
+            auto expanded = function(second);
+            ++evaluations;
+
+            if (expanded < reflected) {
+                simplex[worst] = second;
+                values[worst] = expanded;
+            }
+            else {
+                simplex[worst] = trial;
+                values[worst] = reflected;
+            }
+        }
+        else if (reflected < values[nextWorst]) {
+            simplex[worst] = trial;
+            values[worst] = reflected;
+        }
+        else {
+            pointAlong(second, 0.5);
+            auto contracted = function(second);
+            ++evaluations;
+
+            if (contracted < values[worst]) {
+                simplex[worst] = second;
+                values[worst] = contracted;
+            }
+            else {
+                //shrink towards the best vertex
+                for (size_t i = 0; i <= n; ++i) {
+                    if (i == best)
+                        continue;
+                    for (size_t d = 0; d < n; ++d)
+                        simplex[i][d] = simplex[best][d] + 0.5 * (simplex[i][d] - simplex[best][d]);
+                    values[i] = function(simplex[i]);
+                    ++evaluations;
+                }
+            }
+        }
+    }
+
+    auto best = (size_t)std::distance(values.begin(), std::min_element(values.begin(), values.end()));
+    x = simplex[best];
+    return values[best];
+}
+
+//parameter <-> unit interval, log where the parameter is
+double toUnitLog(double value, double low, double high) { return std::log(value / low) / std::log(high / low); }
+double fromUnitLog(double unit, double low, double high) { return low * std::pow(high / low, unit); }
+
+}
+
+ReferenceMatchResult ReferenceMatcher::fit() const {
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+    MatchModel model(mainSpectrum, referenceSpectrum, sampleRate.load());
+
+    //start from a flat EQ with every stage bypassed
+    ChainSettings best;
+    best.lowCutFreq = getParameterSpec(ParameterId::LowCutFreq).defaultValue;
+    best.highCutFreq = getParameterSpec(ParameterId::HighCutFreq).defaultValue;
+    best.peakFreq = getParameterSpec(ParameterId::PeakFreq).defaultValue;
+    best.lowCutBypassed = best.peakBypassed = best.highCutBypassed = true;
+
+    ReferenceMatchResult result;
+    result.settings = best;
+
+    if (!model.hasData())
+        return result;
+
+    double offset = 0.0;
+    auto bestError = model.getError(best, &offset);
+    result.rmsDifferenceDb = (float)std::sqrt(bestError);
+
+    auto& gainSpec = getParameterSpec(ParameterId::PeakGain);
+    auto& qualitySpec = getParameterSpec(ParameterId::PeakQuality);
+    const double lowCutLow = 20.0, lowCutHigh = 2000.0, highCutLow = 1000.0, highCutHigh = 20000.0;
+    const double peakLow = 25.0, peakHigh = juce::jmin(16000.0, model.sampleRate * 0.45);
+
+    //peak: grid over frequency and Q, gain from a least-squares fit of the
+    //response at a probe gain, which scales close to linearly in dB
+    {
+        const double probeGainDb = 12.0;
+
+        for (int f = 0; f < 40; ++f) {
+            for (auto quality : { 0.3f, 0.7f, 1.4f, 3.f }) {
+                auto candidate = best;
+                candidate.peakBypassed = false;
+                candidate.peakFreq = (float)fromUnitLog(f / 39.0, peakLow, peakHigh);
+                candidate.peakQuality = quality;
+                candidate.peakGainInDecibels = (float)probeGainDb;
+
+                updateMonoChain(model.chain, candidate, model.sampleRate);
+
+                double shape[MatchModel::numPoints];
+                double weightSum = 0.0, shapeMean = 0.0, targetMean = 0.0;
+                for (int k = 0; k < MatchModel::numPoints; ++k) {
+                    shape[k] = juce::Decibels::gainToDecibels(getChainMagnitude(model.chain, model.frequencies[k], model.sampleRate), -200.0);
+                    weightSum += model.weights[k];
+                    shapeMean += model.weights[k] * shape[k];
+                    targetMean += model.weights[k] * model.targetDb[k];
+                }
+
+                shapeMean /= weightSum;
+                targetMean /= weightSum;
+
+                double cross = 0.0, power = 0.0;
+                for (int k = 0; k < MatchModel::numPoints; ++k) {
+                    cross += model.weights[k] * (shape[k] - shapeMean) * (model.targetDb[k] - targetMean);
+                    power += model.weights[k] * (shape[k] - shapeMean) * (shape[k] - shapeMean);
+                }
+
+                if (power <= 0.0)
+                    continue;
+
+                candidate.peakGainInDecibels = (float)juce::jlimit((double)gainSpec.minimum, (double)gainSpec.maximum, probeGainDb * cross / power);
+
+                auto error = model.getError(candidate);
+                if (error < bestError) {
+                    bestError = error;
+                    best = candidate;
+                }
+            }
+        }
+    }
+
+    //cuts: each is only kept when it helps
+    auto tryCut = [&](bool isLowCut) {
+        for (int f = 0; f < 12; ++f) {
+            for (int slope = Slope_12; slope <= Slope_48; ++slope) {
+                auto candidate = best;
+
+                if (isLowCut) {
+                    candidate.lowCutBypassed = false;
+                    candidate.lowCutFreq = (float)fromUnitLog(f / 11.0, lowCutLow, lowCutHigh);
+                    candidate.lowCutSlope = (Slope)slope;
+                }
+                else {
+                    candidate.highCutBypassed = false;
+                    candidate.highCutFreq = (float)fromUnitLog(f / 11.0, highCutLow, highCutHigh);
+                    candidate.highCutSlope = (Slope)slope;
+                }
+
+                auto error = model.getError(candidate);
+                if (error < bestError) {
+                    bestError = error;
+                    best = candidate;
+                }
+            }
+        }
+    };
+
+    tryCut(true);
+    tryCut(false);
+
+    //polish every continuous setting of the stages in use together
+    {
+        auto toSettings = [&](const std::vector<double>& x) {
+            auto settings = best;
+            size_t i = 0;
+
+            if (!settings.peakBypassed) {
+                settings.peakFreq = (float)fromUnitLog(x[i++], peakLow, peakHigh);
+                settings.peakGainInDecibels = (float)juce::jmap(x[i++], (double)gainSpec.minimum, (double)gainSpec.maximum);
+                settings.peakQuality = (float)fromUnitLog(x[i++], qualitySpec.minimum, qualitySpec.maximum);
+            }
+            if (!settings.lowCutBypassed)
+                settings.lowCutFreq = (float)fromUnitLog(x[i++], lowCutLow, lowCutHigh);
+            if (!settings.highCutBypassed)
+                settings.highCutFreq = (float)fromUnitLog(x[i++], highCutLow, highCutHigh);
+
+            return settings;
+        };
+
+        std::vector<double> x;
+        if (!best.peakBypassed) {
+            x.push_back(toUnitLog(best.peakFreq, peakLow, peakHigh));
+            x.push_back(juce::jmap((double)best.peakGainInDecibels, (double)gainSpec.minimum, (double)gainSpec.maximum, 0.0, 1.0));
+            x.push_back(toUnitLog(best.peakQuality, qualitySpec.minimum, qualitySpec.maximum));
+        }
+        if (!best.lowCutBypassed)
+            x.push_back(toUnitLog(best.lowCutFreq, lowCutLow, lowCutHigh));
+        if (!best.highCutBypassed)
+            x.push_back(toUnitLog(best.highCutFreq, highCutLow, highCutHigh));
+
+        if (!x.empty()) {
+            auto error = minimise([&](const std::vector<double>& p) { return model.getError(toSettings(p)); }, x, 0.05, 400);
+            if (error < bestError) {
+                bestError = error;
+                best = toSettings(x);
+            }
+        }
+    }
+
+    //the slopes again, now that the frequencies have moved
+    for (int slope = Slope_12; slope <= Slope_48; ++slope) {
+        for (auto isLowCut : { true, false }) {
+            auto candidate = best;
+            if (isLowCut && !candidate.lowCutBypassed)
+                candidate.lowCutSlope = (Slope)slope;
+            else if (!isLowCut && !candidate.highCutBypassed)
+                candidate.highCutSlope = (Slope)slope;
+            else
+                continue;
+
+            auto error = model.getError(candidate);
+            if (error < bestError) {
+                bestError = error;
+                best = candidate;
+            }
+        }
+    }
+
+    //snap to the parameters' steps so applying the result doesn't move it
+    best.peakGainInDecibels = std::round(best.peakGainInDecibels / gainSpec.interval) * gainSpec.interval;
+    best.peakQuality = juce::jlimit(qualitySpec.minimum, qualitySpec.maximum, std::round(best.peakQuality / qualitySpec.interval) * qualitySpec.interval);
+    best.peakFreq = std::round(best.peakFreq);
+    best.lowCutFreq = std::round(best.lowCutFreq);
+    best.highCutFreq = std::round(best.highCutFreq);
+
+    if (std::abs(best.peakGainInDecibels) < gainSpec.interval)
+        best.peakBypassed = true;
+
+    result.settings = best;
+    result.rmsErrorDb = (float)std::sqrt(model.getError(best, &offset));
+    result.offsetDb = (float)offset;
+    result.numEvaluations = model.numEvaluations;
+    result.fitMilliseconds = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+    return result;
+}
@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    ReferenceMatch.h
+    Long-term spectra of the input and a sidechain reference, and a fit of
+    the EQ's settings to the difference between them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+#include "AnalysisService.h"
+#include "PluginProcessor.h"
+
+/*  Long-term average spectrum by Welch's method: windowed frames of fftSize
+    samples with 50% overlap, power averaged over every frame since the last
+    reset. It is updated incrementally as samples arrive, so the average is
+    always current. Frames of digital silence are left out so pauses don't
+    pull the average down. Analysis thread only. */
+struct LongTermSpectrum {
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 2;
+    static constexpr int numBins = fftSize / 2 + 1;
+
+    void prepare(juce::dsp::FFT& fft, juce::dsp::WindowingFunction<float>& window);
+    void release();
+    void reset();
+
+    void push(const float* samples, int numSamples);
+
+    int getNumFrames() const { return numFrames; }
+    //mean power of 'bin' over all frames; only ratios between two estimates mean anything
+    double getPower(int bin) const { return numFrames > 0 ? powerSums[(size_t)bin] / numFrames : 0.0; }
+
+    size_t getAllocatedBytes() const {
+        return (history.capacity() + fftData.capacity()) * sizeof(float) + powerSums.capacity() * sizeof(double);
+    }
+private:
+    void analyzeFrame();
+
+    juce::dsp::FFT* forwardFFT = nullptr;
+    juce::dsp::WindowingFunction<float>* window = nullptr;
+
+    std::vector<float> history, fftData;
+    std::vector<double> powerSums;
+    int writeIndex = 0, samplesSinceFrame = 0, numFrames = 0;
+};
+
+struct ReferenceMatchResult {
+    ChainSettings settings;
+    //rms difference between the curves over the fitted band, broadband offset removed
+    float rmsDifferenceDb = 0.f, rmsErrorDb = 0.f;
+    //level the reference is above the input overall, which the EQ can't supply
+    float offsetDb = 0.f;
+    int numEvaluations = 0;
+    double fitMilliseconds = 0.0;
+};
+
+/*  Captures the input ahead of the EQ and the sidechain reference, both
+    summed to mono, and keeps a LongTermSpectrum of each on an AnalysisService
+    worker. requestFit() has the worker solve for the cut frequencies and
+    slopes and the peak's frequency, gain and Q whose response, taken from the
+    same model the response curve draws, best matches reference minus input.
+    A broadband level difference is left out of the fit, since no band can
+    supply it. Storage is only held while capturing. */
+struct ReferenceMatcher : AnalysisService::Client {
+    ReferenceMatcher();
+    ~ReferenceMatcher() override;
+
+    void prepare(double sampleRate);
+
+    //audio thread: 'main' is the stereo input before the EQ, 'sidechain' may be empty
+    void push(const juce::dsp::AudioBlock<float>& main, const juce::AudioBuffer<float>& sidechain);
+
+    //message thread. Starting clears both estimates
+    void startCapture();
+    void stopCapture();
+    bool isCapturing() const { return capturing.load(); }
+
+    //frames in the thinner of the two estimates
+    int getNumFrames() const { return numFrames.load(); }
+    int getNumDroppedSamples() const { return droppedSamples.load(); }
+
+    //message thread: fits on the worker, getFitResult() returns true once per new result
+    void requestFit();
+    bool getFitResult(ReferenceMatchResult& result);
+
+    size_t getAllocatedBytes() const;
+
+    void runAnalysis() override;
+private:
+    static constexpr int ringSize = 1 << 16;
+
+    ReferenceMatchResult fit() const;
+    void updateVisibility();
+
+    juce::SharedResourcePointer<AnalysisService> analysisService;
+
+    //audio thread -> worker, the same indices serve both channels
+    juce::AbstractFifo ring { ringSize };
+    std::vector<float> mainRing, referenceRing;
+    juce::SpinLock captureLock;
+    std::atomic<bool> capturing { false };
+    std::atomic<int> droppedSamples { 0 };
+
+    LongTermSpectrum mainSpectrum, referenceSpectrum;
+    std::atomic<int> numFrames { 0 };
+    std::atomic<bool> resetRequested { false };
+    std::atomic<double> sampleRate { 44100.0 };
+
+    std::atomic<bool> fitRequested { false };
+    juce::SpinLock resultLock;
+    ReferenceMatchResult latestResult;
+    bool hasNewResult = false;
+};
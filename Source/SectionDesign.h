@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    SectionDesign.h
+    Analytic biquad section designs shared by the EQ's cuts and the crossover.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+
+//one biquad in juce::dsp::IIR::Coefficients layout: b0, b1, b2, a1, a2 (a0 == 1).
+//first-order sections leave b2 and a2 at zero
+using SectionCoefficients = std::array<float, 5>;
+
+/*  Q of every biquad of a Butterworth filter of order 1 to 8, rounded to float:
+    1 / (2 cos((2i + 1) pi / 2N)) for even orders, which is what
+    FilterDesign::designIIR{High,Low}passHighOrderButterworthMethod computes,
+    and 1 / (2 cos(i pi / N)) for odd orders, whose real pole gets a
+    first-order section instead. */
+constexpr float butterworthSectionQs[8][4] {
+    { },
+    { 0.707106769f },
+    { 1.f },
+    { 0.541196108f, 1.30656302f },
+    { 0.618034005f, 1.61803401f },
+    { 0.517638087f, 0.707106769f, 1.93185163f },
+    { 0.554958105f, 0.801937759f, 2.24697971f },
+    { 0.509795606f, 0.601344883f, 0.899976194f, 2.56291556f }
+};
+
+constexpr int getNumButterworthSections(int order) { return order / 2 + order % 2; }
+
+/*  Writes the sections of a Butterworth high or lowpass of the given order and
+    returns how many it wrote. Even orders match FilterDesign bit for bit (same
+    Qs, same float makeHighPass/makeLowPass formulas); odd orders end with a
+    first-order section. One tan per design, nothing allocated. */
+inline int designButterworthSections(float frequency, double sampleRate, int order, bool isHighpass, SectionCoefficients* sections) {
+    jassert(order >= 1 && order <= 8);
+
+    auto t = std::tan(juce::MathConstants<float>::pi * frequency / static_cast<float>(sampleRate));
+    auto n = isHighpass ? t : 1 / t;
+    auto nSquared = n * n;
+
+    int numSections = 0;
+    for (int i = 0; i < order / 2; ++i) {
+        auto invQ = 1 / butterworthSectionQs[order - 1][i];
+        auto c1 = 1 / (1 + invQ * n + nSquared);
+
+        if (isHighpass)
+            sections[numSections++] = { c1, c1 * -2, c1, c1 * 2 * (nSquared - 1), c1 * (1 - invQ * n + nSquared) };
+        else
+            sections[numSections++] = { c1, c1 * 2, c1, c1 * 2 * (1 - nSquared), c1 * (1 - invQ * n + nSquared) };
+    }
+
+    if (order % 2 == 1) {
+        auto c1 = 1 / (1 + n);
+
+        if (isHighpass)
+            sections[numSections++] = { c1, -c1, 0.f, c1 * (n - 1), 0.f };
+        else
+            sections[numSections++] = { c1, c1, 0.f, c1 * (1 - n), 0.f };
+    }
+
+    return numSections;
+}
+
+//the allpass with the same poles as a section: its numerator is the denominator reversed
+inline SectionCoefficients makeAllpassSection(const SectionCoefficients& section) {
+    auto a1 = section[3], a2 = section[4];
+
+    if (a2 == 0.f)
+        return { a1, 1.f, 0.f, a1, 0.f };
+
+    return { a2, a1, 1.f, a1, a2 };
+}
+
+//samples until a section's impulse response has decayed by decayGain, taken
+//from its slowest pole (the poles are the roots of z^2 + a1 z + a2)
+inline double getPoleDecaySamples(double a1, double a2, double decayGain) {
+    static constexpr double maxDecaySamples = 10.0 * 192000.0;
+
+    double radius = 0.0;
+    auto discriminant = a1 * a1 - 4.0 * a2;
+
+    if (discriminant < 0.0)
+        radius = std::sqrt(a2);
+    else
+        radius = juce::jmax(std::abs((-a1 + std::sqrt(discriminant)) * 0.5),
+            std::abs((-a1 - std::sqrt(discriminant)) * 0.5));
+
+    if (radius <= 0.0)
+        return 2.0;
+    if (radius >= 1.0)
+        return maxDecaySamples;
+
+    return juce::jmin(maxDecaySamples, std::log(decayGain) / std::log(radius));
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    SpectrumSmoother.cpp
+    Fractional-octave smoothing and temporal averaging of analyzer spectra.
+
+  ==============================================================================
+*/
+
+#include "SpectrumSmoother.h"
+
+void SpectrumSmoother::prepare(int numBins) {
+    prefix.assign((size_t)numBins + 1, 0.0);
+    lowerEdges.assign((size_t)numBins, 0);
+    upperEdges.assign((size_t)numBins, 0);
+    power.assign((size_t)numBins, 0.f);
+    averaged.assign((size_t)numBins, 0.f);
+
+    edgesFraction = 0;
+    hasHistory = false;
+}
+
+void SpectrumSmoother::release() {
+    prefix = {};
+    lowerEdges = {};
+    upperEdges = {};
+    power = {};
+    averaged = {};
+
+    edgesFraction = 0;
+    hasHistory = false;
+}
+
+void SpectrumSmoother::updateEdges(int fraction) {
+    auto numBins = (int)lowerEdges.size();
+    auto ratio = std::pow(2.0, 1.0 / (2.0 * fraction));
+
+    for (int bin = 0; bin < numBins; ++bin) {
+        lowerEdges[bin] = juce::jlimit(0, bin, (int)std::floor(bin / ratio));
+        upperEdges[bin] = juce::jlimit(bin, numBins - 1, (int)std::ceil(bin * ratio));
+    }
+
+    edgesFraction = fraction;
+}
+
+void SpectrumSmoother::process(float* magnitudes, int numBins, float frameSeconds) {
+    auto fraction = smoothing.load();
+    auto mode = averaging.load();
+
+    if (fraction == (int)Smoothing::None && mode == (int)Averaging::None) {
+        hasHistory = false;
+        return;
+    }
+
+    jassert(numBins <= (int)power.size());
+
+    for (int bin = 0; bin < numBins; ++bin)
+        power[bin] = magnitudes[bin] * magnitudes[bin];
+
+    if (fraction != (int)Smoothing::None) {
+        if (fraction != edgesFraction)
+            updateEdges(fraction);
+
+        prefix[0] = 0.0;
+        for (int bin = 0; bin < numBins; ++bin)
+            prefix[bin + 1] = prefix[bin] + power[bin];
+
+        for (int bin = 0; bin < numBins; ++bin) {
+            auto lower = lowerEdges[bin];
+            auto upper = upperEdges[bin];
+            power[bin] = float((prefix[upper + 1] - prefix[lower]) / double(upper - lower + 1));
+        }
+    }
+
+    if (mode != lastAveraging) {
+        lastAveraging = mode;
+        hasHistory = false;
+    }
+
+    if (mode != (int)Averaging::None) {
+        auto coefficient = std::exp(-frameSeconds / decaySeconds.load());
+
+        if (!hasHistory) {
+            std::copy(power.begin(), power.begin() + numBins, averaged.begin());
+            hasHistory = true;
+        }
+        else if (mode == (int)Averaging::Exponential) {
+            for (int bin = 0; bin < numBins; ++bin)
+                averaged[bin] = coefficient * averaged[bin] + (1.f - coefficient) * power[bin];
+        }
+        else {
+            for (int bin = 0; bin < numBins; ++bin)
+                averaged[bin] = juce::jmax(power[bin], averaged[bin] * coefficient);
+        }
+
+        std::copy(averaged.begin(), averaged.begin() + numBins, power.begin());
+    }
+
+    for (int bin = 0; bin < numBins; ++bin)
+        magnitudes[bin] = std::sqrt(power[bin]);
+}
@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    SpectrumSmoother.h
+    Fractional-octave smoothing and temporal averaging of analyzer spectra.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+/*  Works in place on the normalised linear magnitudes of one analyzer, on the
+    analysis thread, with buffers sized in prepare(). Smoothing averages power
+    over +-1/(2n) octave around each bin using a prefix sum, so it is O(bins)
+    whatever the width. Averaging is done on power as well: exponential with a
+    time constant of decaySeconds, or peak hold that falls by 1/e every
+    decaySeconds. The setters are safe to call from the message thread. */
+struct SpectrumSmoother {
+    enum class Smoothing {
+        None = 0,
+        ThirdOctave = 3,
+        SixthOctave = 6,
+        TwelfthOctave = 12,
+        TwentyFourthOctave = 24
+    };
+
+    enum class Averaging {
+        None,
+        Exponential,
+        PeakHold
+    };
+
+    void prepare(int numBins);
+    //frees the buffers, prepare() has to run again before process()
+    void release();
+
+    size_t getAllocatedBytes() const {
+        return prefix.capacity() * sizeof(double) + (lowerEdges.capacity() + upperEdges.capacity()) * sizeof(int)
+            + (power.capacity() + averaged.capacity()) * sizeof(float);
+    }
+
+    void setSmoothing(Smoothing newSmoothing) { smoothing.store((int)newSmoothing); }
+    void setAveraging(Averaging newAveraging, float newDecaySeconds) {
+        decaySeconds.store(juce::jmax(0.001f, newDecaySeconds));
+        averaging.store((int)newAveraging);
+    }
+
+    //'frameSeconds' is the time between two successive spectra
+    void process(float* magnitudes, int numBins, float frameSeconds);
+private:
+    void updateEdges(int fraction);
+
+    std::atomic<int> smoothing { (int)Smoothing::None }, averaging { (int)Averaging::None };
+    std::atomic<float> decaySeconds { 0.5f };
+
+    int edgesFraction = 0, lastAveraging = (int)Averaging::None;
+    bool hasHistory = false;
+
+    std::vector<double> prefix;
+    std::vector<int> lowerEdges, upperEdges;
+    std::vector<float> power, averaged;
+};
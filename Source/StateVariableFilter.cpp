@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+    StateVariableFilter.cpp
+    Benchmark of the state-variable backend against the biquads.
+
+  ==============================================================================
+*/
+
+#include "StateVariableFilter.h"
+#include "EQCore.h"
+
+namespace {
+
+ChainSettings getBenchmarkSettings(float peakFreq) {
+    ChainSettings settings;
+    settings.lowCutFreq = 80.f;
+    settings.lowCutSlope = Slope_48;
+    settings.highCutFreq = 12000.f;
+    settings.highCutSlope = Slope_48;
+    settings.peakFreq = peakFreq;
+    settings.peakGainInDecibels = 6.f;
+    settings.peakQuality = 1.f;
+    return settings;
+}
+
+//what updateFilters() does for the state-variable backend
+void updateSvfChain(SvfChain& chain, const ChainSettings& settings, double sampleRate) {
+    std::array<SvfSection, 4> sections;
+
+    auto numSections = designButterworthSvf(settings.lowCutFreq, sampleRate, 2 * (settings.lowCutSlope + 1), true, sections.data());
+    chain.lowCut.setSections(sections.data(), numSections);
+
+    numSections = designButterworthSvf(settings.highCutFreq, sampleRate, 2 * (settings.highCutSlope + 1), false, sections.data());
+    chain.highCut.setSections(sections.data(), numSections);
+
+    auto peak = designPeakSvf(settings.peakFreq, sampleRate, settings.peakQuality, settings.peakGainInDecibels);
+    chain.peak.setSections(&peak, 1);
+}
+
+double getTickNanoseconds(juce::int64 ticks) {
+    return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9;
+}
+
+//the peak swept between 200 Hz and 5 kHz over the run
+float getSweptFrequency(int block, int numBlocks) {
+    auto phase = juce::MathConstants<float>::twoPi * (float)block / (float)juce::jmax(1, numBlocks);
+    return juce::mapToLog10(0.5f + 0.5f * std::sin(phase), 200.f, 5000.f);
+}
+
+}
+
+FilterBackendBenchmark benchmarkFilterBackends(double sampleRate, int blockSize, int numSamples) {
+    FilterBackendBenchmark result;
+
+    blockSize = juce::jmax(1, blockSize);
+    auto numBlocks = juce::jmax(1, numSamples / blockSize);
+    numSamples = numBlocks * blockSize;
+
+    juce::AudioBuffer<float> noise(1, numSamples), biquadOutput(1, numSamples), svfOutput(1, numSamples);
+    juce::Random random(0x5eed);
+    for (int n = 0; n < numSamples; ++n)
+        noise.setSample(0, n, random.nextFloat() * 2.f - 1.f);
+
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32)blockSize, 1 };
+    auto settings = getBenchmarkSettings(1000.f);
+
+    MonoChain biquads;
+    biquads.prepare(spec);
+    SvfChain svfs;
+
+    auto runBiquads = [&](bool modulate) {
+        biquads.reset();
+        updateMonoChain(biquads, settings, sampleRate);
+        biquadOutput.makeCopyOf(noise, true);
+
+        juce::dsp::AudioBlock<float> block(biquadOutput);
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b) {
+            if (modulate)
+                updateMonoChain(biquads, getBenchmarkSettings(getSweptFrequency(b, numBlocks)), sampleRate);
+
+            auto subBlock = block.getSubBlock((size_t)(b * blockSize), (size_t)blockSize);
+            juce::dsp::ProcessContextReplacing<float> context(subBlock);
+            biquads.process(context);
+        }
+
+        return getTickNanoseconds(juce::Time::getHighResolutionTicks() - start) / numSamples;
+    };
+
+    auto runSvfs = [&](bool modulate) {
+        updateSvfChain(svfs, settings, sampleRate);
+        svfs.reset();
+        svfOutput.makeCopyOf(noise, true);
+
+        auto* samples = svfOutput.getWritePointer(0);
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b) {
+            if (modulate)
+                updateSvfChain(svfs, getBenchmarkSettings(getSweptFrequency(b, numBlocks)), sampleRate);
+
+            auto* blockSamples = samples + b * blockSize;
+            svfs.lowCut.process(blockSamples, blockSize);
+            svfs.peak.process(blockSamples, blockSize);
+            svfs.highCut.process(blockSamples, blockSize);
+        }
+
+        return getTickNanoseconds(juce::Time::getHighResolutionTicks() - start) / numSamples;
+    };
+
+    //one untimed pass each to warm caches and the allocator
+    runBiquads(false);
+    runSvfs(false);
+
+    result.biquadModulatedNsPerSample = runBiquads(true);
+    result.svfModulatedNsPerSample = runSvfs(true);
+
+    //static last, so the outputs compared below are from the same settings
+    result.biquadNsPerSample = runBiquads(false);
+    result.svfNsPerSample = runSvfs(false);
+
+    double peak = 0.0, maxDifference = 0.0;
+    for (int n = 0; n < numSamples; ++n) {
+        peak = juce::jmax(peak, (double)std::abs(biquadOutput.getSample(0, n)));
+        maxDifference = juce::jmax(maxDifference, (double)std::abs(biquadOutput.getSample(0, n) - svfOutput.getSample(0, n)));
+    }
+    result.maxOutputErrorDb = juce::Decibels::gainToDecibels(peak > 0.0 ? maxDifference / peak : 0.0, -200.0);
+
+    for (int k = 0; k < 200; ++k) {
+        auto frequency = juce::mapToLog10(k / 199.0, 20.0, juce::jmin(20000.0, sampleRate * 0.45));
+        auto biquadDb = juce::Decibels::gainToDecibels(getChainMagnitude(biquads, frequency, sampleRate), -200.0);
+        auto svfDb = juce::Decibels::gainToDecibels(svfs.lowCut.getMagnitudeForFrequency(frequency, sampleRate)
+            * svfs.peak.getMagnitudeForFrequency(frequency, sampleRate)
+            * svfs.highCut.getMagnitudeForFrequency(frequency, sampleRate), -200.0);
+
+        //deeper in the cuts' stopbands the biquads' rounding is all that differs
+        if (biquadDb > -60.0)
+            result.maxMagnitudeErrorDb = juce::jmax(result.maxMagnitudeErrorDb, std::abs(biquadDb - svfDb));
+    }
+
+    //the backends are meant to be interchangeable
+    jassert(result.isWithinTolerance());
+
+    //redesign cost alone, sweeping so no call sees unchanged settings
+    const int numUpdates = 1000;
+
+    auto start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < numUpdates; ++i)
+        updateMonoChain(biquads, getBenchmarkSettings(getSweptFrequency(i, numUpdates)), sampleRate);
+    result.biquadUpdateNs = getTickNanoseconds(juce::Time::getHighResolutionTicks() - start) / numUpdates;
+
+    start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < numUpdates; ++i)
+        updateSvfChain(svfs, getBenchmarkSettings(getSweptFrequency(i, numUpdates)), sampleRate);
+    result.svfUpdateNs = getTickNanoseconds(juce::Time::getHighResolutionTicks() - start) / numUpdates;
+
+    return result;
+}
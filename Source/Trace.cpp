@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    Trace.cpp
+    Optional timeline of timestamped scopes on the audio, worker and message
+    threads, written out as a Chrome trace (chrome://tracing, Perfetto).
+
+  ==============================================================================
+*/
+
+#include "Trace.h"
+
+#if EQ_TRACING
+
+Tracer& Tracer::getInstance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Ring* Tracer::getThreadRing() {
+    //claimed once per thread, nullptr for good once the pool has run out
+    thread_local Ring* ring = [this]() -> Ring* {
+        auto index = numRingsClaimed.fetch_add(1);
+        return index < maxThreads ? &rings[(size_t)index] : nullptr;
+    }();
+
+    return ring;
+}
+
+void Tracer::record(const char* name, juce::int64 startTicks, juce::int64 endTicks) {
+    auto* ring = getThreadRing();
+    if (ring == nullptr)
+        return;
+
+    //only the owning thread writes, so a relaxed read of its own count is enough
+    auto count = ring->numWritten.load(std::memory_order_relaxed);
+    ring->events[(size_t)(count % eventsPerThread)] = { name, startTicks, endTicks };
+    ring->numWritten.store(count + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name) {
+    if (auto* ring = getThreadRing())
+        ring->threadName.store(name, std::memory_order_relaxed);
+}
+
+bool Tracer::writeChromeTrace(const juce::File& file) const {
+    auto ticksToMicroseconds = [](juce::int64 ticks) {
+        return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6;
+    };
+
+    juce::String json;
+    json << "{\"traceEvents\":[\n";
+    auto first = true;
+
+    auto numRings = juce::jmin(numRingsClaimed.load(), maxThreads);
+    std::vector<Event> copied;
+    copied.reserve(eventsPerThread);
+
+    for (int t = 0; t < numRings; ++t) {
+        auto& ring = rings[(size_t)t];
+
+        auto endBefore = ring.numWritten.load(std::memory_order_acquire);
+        auto begin = endBefore > (juce::uint64)eventsPerThread ? endBefore - eventsPerThread : 0;
+
+        copied.clear();
+        for (auto i = begin; i < endBefore; ++i)
+            copied.push_back(ring.events[(size_t)(i % eventsPerThread)]);
+
+        //the owner kept writing meanwhile: anything it may have reached is unreliable,
+        //including the slot of index endAfter, which it may be writing right now
+        auto endAfter = ring.numWritten.load(std::memory_order_acquire);
+        auto firstReliable = endAfter >= (juce::uint64)eventsPerThread ? endAfter - eventsPerThread + 1 : 0;
+        auto skip = (size_t)juce::jmin<juce::uint64>(copied.size(), firstReliable > begin ? firstReliable - begin : 0);
+
+        auto tid = t + 1;
+        if (auto* threadName = ring.threadName.load(std::memory_order_relaxed)) {
+            json << (first ? "" : ",\n")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+            first = false;
+        }
+
+        for (auto i = skip; i < copied.size(); ++i) {
+            auto& event = copied[i];
+            json << (first ? "" : ",\n")
+                << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << juce::String(ticksToMicroseconds(event.startTicks), 3)
+                << ",\"dur\":" << juce::String(ticksToMicroseconds(event.endTicks - event.startTicks), 3) << "}";
+            first = false;
+        }
+    }
+
+    json << "\n]}\n";
+    return file.replaceWithText(json);
+}
+
+bool writeTraceFile(const juce::File& file) {
+    return Tracer::getInstance().writeChromeTrace(file);
+}
+
+#else
+
+bool writeTraceFile(const juce::File&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    Trace.h
+    Optional timeline of timestamped scopes on the audio, worker and message
+    threads, written out as a Chrome trace (chrome://tracing, Perfetto).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//set to 1 in the project's preprocessor definitions to build the tracer in
+#ifndef EQ_TRACING
+ #define EQ_TRACING 0
+#endif
+
+#if EQ_TRACING
+
+#include <array>
+#include <atomic>
+
+/*  Every thread that records gets a ring of its own, claimed from a pool
+    allocated up front, so recording never allocates, locks or waits: a scope
+    costs two timestamps and one store into the ring. The oldest events are
+    overwritten once a ring is full. Rings are read without stopping the
+    threads that own them, and events a thread may have overwritten while
+    being copied are dropped from the dump. */
+struct Tracer {
+    static constexpr int maxThreads = 16;
+    static constexpr int eventsPerThread = 8192;
+
+    struct Event {
+        //names must be string literals, only the pointer is stored
+        const char* name;
+        juce::int64 startTicks, endTicks;
+    };
+
+    static Tracer& getInstance();
+
+    //threads past the first maxThreads to record are not traced
+    void record(const char* name, juce::int64 startTicks, juce::int64 endTicks);
+    //labels the calling thread's row in the dump, 'name' must be a string literal
+    void setThreadName(const char* name);
+
+    //message thread: writes everything still in the rings as a Chrome trace
+    bool writeChromeTrace(const juce::File& file) const;
+private:
+    Tracer() = default;
+
+    struct Ring {
+        std::array<Event, eventsPerThread> events;
+        std::atomic<juce::uint64> numWritten { 0 };
+        std::atomic<const char*> threadName { nullptr };
+    };
+
+    Ring* getThreadRing();
+
+    std::array<Ring, maxThreads> rings;
+    std::atomic<int> numRingsClaimed { 0 };
+};
+
+struct TraceScope {
+    explicit TraceScope(const char* scopeName) : name(scopeName), startTicks(juce::Time::getHighResolutionTicks()) { }
+    ~TraceScope() { Tracer::getInstance().record(name, startTicks, juce::Time::getHighResolutionTicks()); }
+private:
+    const char* name;
+    juce::int64 startTicks;
+};
+
+#define EQ_TRACE_SCOPE(name) const TraceScope JUCE_JOIN_MACRO(traceScope, __LINE__) (name)
+#define EQ_TRACE_THREAD_NAME(name) Tracer::getInstance().setThreadName(name)
+
+#else
+
+#define EQ_TRACE_SCOPE(name)
+#define EQ_TRACE_THREAD_NAME(name)
+
+#endif
+
+//false when tracing is compiled out or the file can't be written
+bool writeTraceFile(const juce::File& file);